@@ -4,6 +4,9 @@
 ptrs_jit_var_t ptrs_jit_call(ptrs_ast_t *node, jit_function_t func, ptrs_scope_t *scope,
 	ptrs_typing_t *retType, jit_value_t thisPtr, ptrs_jit_var_t callee, struct ptrs_astlist *args);
 
+ptrs_jit_var_t ptrs_jit_callPrototype(ptrs_ast_t *node, jit_function_t func, ptrs_scope_t *scope,
+	void *target, struct ptrs_nativeprototype *prototype, struct ptrs_astlist *args);
+
 ptrs_jit_var_t ptrs_jit_ncallnested(ptrs_ast_t *node, jit_function_t func, ptrs_scope_t *scope,
 	jit_value_t thisPtr, jit_function_t callee, size_t narg, ptrs_jit_var_t *args);
 ptrs_jit_var_t ptrs_jit_callnested(ptrs_ast_t *node, jit_function_t func, ptrs_scope_t *scope,
@@ -18,7 +21,13 @@ jit_function_t ptrs_jit_createFunction(ptrs_ast_t *node, jit_function_t parent,
 	jit_type_t signature, const char *name);
 jit_function_t ptrs_jit_createFunctionFromAst(ptrs_ast_t *node, jit_function_t parent,
 	ptrs_function_t *ast);
+void ptrs_jit_setLoopOptimization(jit_function_t func, ptrs_scope_t *scope);
+bool ptrs_jit_compileFunction(jit_function_t func);
+jit_type_t ptrs_jit_getSignature(jit_abi_t abi, jit_type_t retType, jit_type_t *params, unsigned count);
+void ptrs_jit_printCompileStats();
 void ptrs_jit_buildFunction(ptrs_ast_t *node, jit_function_t func, ptrs_scope_t *scope,
 	ptrs_function_t *ast, ptrs_struct_t *thisType);
+void ptrs_jit_buildClone(ptrs_ast_t *node, jit_function_t parent, ptrs_scope_t *scope,
+	jit_function_t generic, ptrs_function_t *ast, struct ptrs_functionclone *clone);
 
 #endif
@@ -10,6 +10,7 @@ extern FILE *ptrs_errorfile;
 extern ptrs_ast_t *ptrs_lastAst;
 extern bool ptrs_enableExceptions;
 extern bool ptrs_enableSafety;
+extern __thread jmp_buf *ptrs_errorRecovery;
 
 typedef struct
 {
@@ -21,13 +22,15 @@ typedef struct
 typedef struct ptrs_error
 {
 	const char *message;
-	char *backtrace;
+	char *backtrace; //NULL until requested using ptrs_getBacktrace
 	const char *file;
 	int messageLen;
 	int backtraceLen;
 	int fileLen;
 	ptrs_ast_t *ast;
 	ptrs_codepos_t pos;
+	jit_stack_trace_t trace;
+	int traceSkip;
 } ptrs_error_t;
 
 typedef struct ptrs_catcher_labels
@@ -44,6 +47,7 @@ ptrs_error_t *ptrs_createError(ptrs_ast_t *ast, int skipTrace, const char *messa
 
 void ptrs_handle_signals();
 void ptrs_printError(ptrs_error_t *error);
+char *ptrs_getBacktrace(ptrs_error_t *error);
 void ptrs_error(ptrs_ast_t *ast, const char *msg, ...);
 
 struct ptrs_assertion *ptrs_jit_vassert(ptrs_ast_t *ast, jit_function_t func, ptrs_scope_t *scope,
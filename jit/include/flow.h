@@ -4,6 +4,7 @@
 #include "../../parser/common.h"
 #include "../../parser/ast.h"
 
-void ptrs_flow_analyze(ptrs_ast_t *ast);
+void ptrs_flow_analyze(ptrs_ast_t *ast, bool isModule);
+bool ptrs_flow_analyzeClone(ptrs_function_t *ast, uint8_t *types);
 
 #endif
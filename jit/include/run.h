@@ -2,17 +2,20 @@
 #define _PTRS_RUN
 
 #include "../../parser/common.h"
+#include "../../parser/ast.h"
 
 typedef struct
 {
 	ptrs_ast_t *ast;
 	ptrs_symboltable_t *symbols;
+	ptrs_arena_t *arena;
 	jit_function_t func;
 	void *funcFrame;
 } ptrs_result_t;
 
 extern jit_context_t ptrs_jit_context;
 extern bool ptrs_compileAot;
+extern bool ptrs_compileLazy;
 extern bool ptrs_analyzeFlow;
 
 void ptrs_compile(ptrs_result_t *result, char *src, const char *filename);
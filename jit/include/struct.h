@@ -5,6 +5,20 @@
 
 #include "../../parser/common.h"
 
+#define PTRS_STRUCT_CACHE_SIZE 4
+
+// inline cache of a member access with a constant name on a value of unknown type.
+// The jitted code checks varMeta and loads the member at varOffset directly, all
+// other members are looked up in the polymorphic part before hashing the name
+typedef struct
+{
+	uint64_t varMeta; // struct of the last resolved variable member
+	uintptr_t varOffset;
+	unsigned next;
+	uint64_t meta[PTRS_STRUCT_CACHE_SIZE];
+	struct ptrs_structmember *member[PTRS_STRUCT_CACHE_SIZE];
+} ptrs_structcache_t;
+
 struct ptrs_opoverload *ptrs_struct_getOverloadInfo(ptrs_struct_t *struc, void *handler, bool isInstance);
 jit_function_t ptrs_struct_getOverload(ptrs_struct_t *struc, void *handler, bool isInstance);
 void *ptrs_struct_getOverloadClosure(ptrs_struct_t *struc, void *handler, bool isInstance);
@@ -23,6 +37,8 @@ ptrs_var_t ptrs_struct_getMember(ptrs_ast_t *ast, void *data, ptrs_struct_t *str
 	struct ptrs_structmember *member);
 ptrs_var_t ptrs_struct_get(ptrs_ast_t *ast, void *instance, ptrs_meta_t meta,
 	const char *key, uint32_t keyLen);
+ptrs_var_t ptrs_struct_getCached(ptrs_ast_t *ast, void *instance, ptrs_meta_t meta,
+	const char *key, uint32_t keyLen, ptrs_structcache_t *cache);
 ptrs_jit_var_t ptrs_jit_struct_get(ptrs_ast_t *node, jit_function_t func, ptrs_scope_t *scope,
 	ptrs_jit_var_t base, jit_value_t key, jit_value_t keyLen);
 
@@ -30,6 +46,8 @@ void ptrs_struct_setMember(ptrs_ast_t *ast, void *data, ptrs_struct_t *struc,
 	struct ptrs_structmember *member, ptrs_val_t val, ptrs_meta_t meta);
 void ptrs_struct_set(ptrs_ast_t *ast, void *instance, ptrs_meta_t meta,
 	const char *key, uint32_t keyLen, ptrs_val_t val, ptrs_meta_t valMeta);
+void ptrs_struct_setCached(ptrs_ast_t *ast, void *instance, ptrs_meta_t meta,
+	const char *key, uint32_t keyLen, ptrs_val_t val, ptrs_meta_t valMeta, ptrs_structcache_t *cache);
 void ptrs_jit_struct_set(ptrs_ast_t *node, jit_function_t func, ptrs_scope_t *scope,
 	ptrs_jit_var_t base, jit_value_t key, jit_value_t keyLen, ptrs_jit_var_t value);
 
@@ -45,6 +63,6 @@ ptrs_jit_var_t ptrs_jit_struct_call(ptrs_ast_t *node, jit_function_t func, ptrs_
 	ptrs_typing_t *retType, struct ptrs_astlist *args);
 
 ptrs_jit_var_t ptrs_struct_construct(ptrs_ast_t *ast, jit_function_t func, ptrs_scope_t *scope,
-	ptrs_jit_var_t constructor, struct ptrs_astlist *arguments, bool allocateOnStack);
+	ptrs_jit_var_t constructor, struct ptrs_astlist *arguments, bool allocateOnStack, bool reuseStack);
 
 #endif
@@ -45,8 +45,8 @@ jit_value_t ptrs_jit_import(ptrs_ast_t *node, jit_function_t func, jit_value_t v
 			ptrs_util_pasteTuple types \
 		}; \
 		\
-		name = jit_type_create_signature(jit_abi_cdecl, retType, argDef, \
-			sizeof(argDef) / sizeof(jit_type_t), 0); \
+		name = ptrs_jit_getSignature(jit_abi_cdecl, retType, argDef, \
+			sizeof(argDef) / sizeof(jit_type_t)); \
 	}
 
 #define ptrs_jit_reusableCall(func, callee, retVal, retType, types, args) \
@@ -10,6 +10,11 @@
 #define PTRS_HANDLE_ASTERROR(ast, ...) \
 	ptrs_error(ast, __VA_ARGS__)
 
+#define PTRS_HANDLE_SCRIPTIMPORT(file, from) \
+	ptrs_prefetchImport(file, from)
+
+void ptrs_prefetchImport(const char *file, const char *from);
+
 ptrs_jit_var_t ptrs_handle_initroot(ptrs_ast_t *node, jit_function_t func, ptrs_scope_t *scope);
 ptrs_jit_var_t ptrs_handle_body(ptrs_ast_t *node, jit_function_t func, ptrs_scope_t *scope);
 ptrs_jit_var_t ptrs_handle_define(ptrs_ast_t *node, jit_function_t func, ptrs_scope_t *scope);
@@ -1,4 +1,6 @@
+#include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #include "../../parser/common.h"
 #include "../../parser/ast.h"
@@ -8,11 +10,167 @@
 #include "../include/astlist.h"
 #include "../include/conversion.h"
 #include "../include/call.h"
+#include "../include/flow.h"
 #include "jit/jit-type.h"
+#include "jit/jit-dump.h"
 
 int ptrs_optimizationLevel = -1;
+bool ptrs_optimizeLoops = false;
+bool ptrs_compileStats = false;
+bool ptrs_dumpOnDemand = false;
+
+#define PTRS_OPTIMIZATION_LEVELS 8
+static unsigned levelFunctionCount[PTRS_OPTIMIZATION_LEVELS];
+static double levelCompileTime[PTRS_OPTIMIZATION_LEVELS];
+
+// signatures are interned in a table shared by all functions of the context,
+// call sites with the same prototype then use the same jit_type_t instead of
+// creating and freeing one each
+struct ptrs_signature
+{
+	jit_abi_t abi;
+	jit_type_t retType;
+	jit_type_t *params;
+	unsigned count;
+	jit_type_t signature;
+};
+static struct ptrs_signature *signatureTable = NULL;
+static uint32_t signatureCapacity = 0;
+static uint32_t signatureCount = 0;
+static unsigned signatureRequests = 0;
+
+static uint32_t hashSignature(jit_abi_t abi, jit_type_t retType, jit_type_t *params, unsigned count)
+{
+	// FNV-1a over the type pointers
+	uint32_t hash = 2166136261u;
+	hash = (hash ^ (uint32_t)abi) * 16777619u;
+	hash = (hash ^ (uint32_t)((uintptr_t)retType >> 4)) * 16777619u;
+	for(unsigned i = 0; i < count; i++)
+		hash = (hash ^ (uint32_t)((uintptr_t)params[i] >> 4)) * 16777619u;
+	return hash;
+}
+
+static struct ptrs_signature *findSignature(jit_abi_t abi, jit_type_t retType,
+	jit_type_t *params, unsigned count, uint32_t hash)
+{
+	uint32_t mask = signatureCapacity - 1;
+	uint32_t i = hash & mask;
+	while(signatureTable[i].signature != NULL)
+	{
+		struct ptrs_signature *curr = &signatureTable[i];
+		if(curr->abi == abi && curr->retType == retType && curr->count == count
+			&& memcmp(curr->params, params, count * sizeof(jit_type_t)) == 0)
+			break;
+
+		i = (i + 1) & mask;
+	}
+
+	return &signatureTable[i];
+}
+
+static void growSignatureTable()
+{
+	struct ptrs_signature *old = signatureTable;
+	uint32_t oldCapacity = signatureCapacity;
+
+	signatureCapacity = oldCapacity == 0 ? 64 : oldCapacity * 2;
+	signatureTable = calloc(signatureCapacity, sizeof(struct ptrs_signature));
+	if(signatureTable == NULL)
+		abort();
+
+	for(uint32_t i = 0; i < oldCapacity; i++)
+	{
+		struct ptrs_signature *curr = &old[i];
+		if(curr->signature == NULL)
+			continue;
+
+		uint32_t hash = hashSignature(curr->abi, curr->retType, curr->params, curr->count);
+		*findSignature(curr->abi, curr->retType, curr->params, curr->count, hash) = *curr;
+	}
+
+	free(old);
+}
+
+jit_type_t ptrs_jit_getSignature(jit_abi_t abi, jit_type_t retType, jit_type_t *params, unsigned count)
+{
+	signatureRequests++;
+
+	if((signatureCount + 1) * 4 > signatureCapacity * 3)
+		growSignatureTable();
+
+	uint32_t hash = hashSignature(abi, retType, params, count);
+	struct ptrs_signature *slot = findSignature(abi, retType, params, count, hash);
+	if(slot->signature == NULL)
+	{
+		slot->abi = abi;
+		slot->retType = retType;
+		slot->count = count;
+		slot->params = malloc(count * sizeof(jit_type_t) + 1);
+		if(slot->params == NULL)
+			abort();
+		memcpy(slot->params, params, count * sizeof(jit_type_t));
+
+		slot->signature = jit_type_create_signature(abi, retType, params, count, 1);
+		signatureCount++;
+	}
+
+	return slot->signature;
+}
 
 void *ptrs_jit_createCallback(ptrs_ast_t *node, jit_function_t func, ptrs_scope_t *scope, void *closure);
+static int compileOnDemand(jit_function_t func);
+void *ptrs_jit_getCallback(ptrs_ast_t *node, void *closure, void *parentFrame);
+
+static jit_value_t functionToCallback(ptrs_ast_t *node, jit_function_t func, ptrs_scope_t *scope,
+	ptrs_jit_var_t val)
+{
+	if(jit_value_is_constant(val.val))
+	{
+		void *closure = ptrs_jit_value_getValConstant(val.val).ptrval;
+		jit_function_t funcArg = jit_function_from_closure(ptrs_jit_context, closure);
+		if(funcArg && jit_function_get_nested_parent(funcArg) == scope->rootFunc)
+		{
+			void *callback = ptrs_jit_createCallback(node, funcArg, scope, closure);
+			return jit_const_int(func, void_ptr, (uintptr_t)callback);
+		}
+	}
+
+	// closures of nested functions need their parent frame bound,
+	// fetch a pooled trampoline for it at runtime
+	jit_value_t callback;
+	ptrs_jit_reusableCall(func, ptrs_jit_getCallback, callback, jit_type_void_ptr,
+		(jit_type_void_ptr, jit_type_long, jit_type_void_ptr),
+		(jit_const_int(func, void_ptr, (uintptr_t)node), val.val,
+			ptrs_jit_getMetaPointer(func, val.meta))
+	);
+	return callback;
+}
+
+static jit_value_t nativeArgument(ptrs_ast_t *node, jit_function_t func, ptrs_scope_t *scope,
+	ptrs_jit_var_t val, jit_type_t *type)
+{
+	switch(val.constType)
+	{
+		case PTRS_TYPE_UNDEFINED:
+			*type = jit_type_long;
+			return jit_const_int(func, long, 0);
+		case -1:
+			//TODO this should get special care
+			/* fallthrough */
+		case PTRS_TYPE_INT:
+			*type = jit_type_long;
+			return val.val;
+		case PTRS_TYPE_FLOAT:
+			*type = jit_type_float64;
+			return ptrs_jit_reinterpretCast(func, val.val, jit_type_float64);
+		case PTRS_TYPE_FUNCTION:
+			*type = jit_type_void_ptr;
+			return functionToCallback(node, func, scope, val);
+		default: //pointer type
+			*type = jit_type_void_ptr;
+			return val.val;
+	}
+}
 
 ptrs_jit_var_t ptrs_jit_call(ptrs_ast_t *node, jit_function_t func, ptrs_scope_t *scope,
 	ptrs_typing_t *retType, jit_value_t thisPtr, ptrs_jit_var_t callee, struct ptrs_astlist *args)
@@ -66,12 +224,11 @@ ptrs_jit_var_t ptrs_jit_call(ptrs_ast_t *node, jit_function_t func, ptrs_scope_t
 				}
 
 				jit_value_t parentFrame = ptrs_jit_getMetaPointer(func, callee.meta);
-				jit_type_t signature = jit_type_create_signature(jit_abi_cdecl,
-					ptrs_jit_getVarType(), paramDef, narg * 2 + 1, 0);
+				jit_type_t signature = ptrs_jit_getSignature(jit_abi_cdecl,
+					ptrs_jit_getVarType(), paramDef, narg * 2 + 1);
 
 				jit_value_t retVal = jit_insn_call_nested_indirect(func, callee.val,
 					parentFrame, signature, _args, narg * 2 + 1, 0);
-				jit_type_free(signature);
 
 				ptrs_jit_var_t _ret = ptrs_jit_valToVar(func, retVal);
 				jit_insn_store(func, ret.val, _ret.val);
@@ -82,59 +239,7 @@ ptrs_jit_var_t ptrs_jit_call(ptrs_ast_t *node, jit_function_t func, ptrs_scope_t
 		case PTRS_TYPE_POINTER:
 			{
 				for(int i = 0; i < narg; i++)
-				{
-					switch(evaledArgs[i].constType)
-					{
-						case PTRS_TYPE_UNDEFINED:
-							paramDef[i] = jit_type_long;
-							_args[i] = jit_const_int(func, long, 0);
-							break;
-						case -1:
-							//TODO this should get special care
-							/* fallthrough */
-						case PTRS_TYPE_INT:
-							paramDef[i] = jit_type_long;
-							_args[i] = evaledArgs[i].val;
-							break;
-						case PTRS_TYPE_FLOAT:
-							paramDef[i] = jit_type_float64;
-							_args[i] = ptrs_jit_reinterpretCast(func, evaledArgs[i].val, jit_type_float64);
-							break;
-						case PTRS_TYPE_FUNCTION:
-							if(jit_value_is_constant(evaledArgs[i].val))
-							{
-								void *closure = ptrs_jit_value_getValConstant(evaledArgs[i].val).ptrval;
-								jit_function_t funcArg = jit_function_from_closure(ptrs_jit_context, closure);
-								if(funcArg && jit_function_get_nested_parent(funcArg) == scope->rootFunc)
-								{
-									void *callback = ptrs_jit_createCallback(node, funcArg, scope, closure);
-									paramDef[i] = jit_type_void_ptr;
-									_args[i] = jit_const_int(func, void_ptr, (uintptr_t)callback);
-									break;
-								}
-							}
-
-							if(!ptrs_compileAot) // XXX hacky to not throw an error with --asmdump --no-aot
-							{
-								paramDef[i] = jit_type_void_ptr;
-								_args[i] = evaledArgs[i].val;
-								break;
-							}
-
-							//TODO create callbacks at runtime
-							curr = args;
-							while(i-- > 0)
-								curr = curr->next;
-							ptrs_error(curr->entry, "Cannot pass nested PointerScript function"
-								" as an argument to a native function");
-
-							break;
-						default: //pointer type
-							paramDef[i] = jit_type_void_ptr;
-							_args[i] = evaledArgs[i].val;
-							break;
-					}
-				}
+					_args[i] = nativeArgument(node, func, scope, evaledArgs[i], &paramDef[i]);
 
 				jit_type_t _retType = ptrs_jit_jitTypeFromTyping(retType);
 				ptrs_meta_t retMeta = {0};
@@ -143,9 +248,8 @@ ptrs_jit_var_t ptrs_jit_call(ptrs_ast_t *node, jit_function_t func, ptrs_scope_t
 				else
 					memcpy(&retMeta, &retType->meta, sizeof(ptrs_meta_t));
 
-				jit_type_t signature = jit_type_create_signature(jit_abi_cdecl, _retType, paramDef, narg, 0);
+				jit_type_t signature = ptrs_jit_getSignature(jit_abi_cdecl, _retType, paramDef, narg);
 				jit_value_t retVal = jit_insn_call_indirect(func, callee.val, signature, _args, narg, 0);
-				jit_type_free(signature);
 
 				retVal = ptrs_jit_normalizeForVar(func, retVal);
 				jit_value_t retMetaVal = jit_const_long(func, ulong, *(uint64_t *)&retMeta);
@@ -168,6 +272,83 @@ ptrs_jit_var_t ptrs_jit_call(ptrs_ast_t *node, jit_function_t func, ptrs_scope_t
 	return ret;
 }
 
+ptrs_jit_var_t ptrs_jit_callPrototype(ptrs_ast_t *node, jit_function_t func, ptrs_scope_t *scope,
+	void *target, struct ptrs_nativeprototype *prototype, struct ptrs_astlist *args)
+{
+	int narg = ptrs_astlist_length(args);
+	if(narg < prototype->paramCount || (narg > prototype->paramCount && !prototype->variadic))
+	{
+		ptrs_error(node, "Function %s expects %s%d arguments, but %d were given", prototype->name,
+			prototype->variadic ? "at least " : "", prototype->paramCount, narg);
+	}
+
+	jit_type_t paramDef[narg];
+	jit_value_t _args[narg];
+
+	// the declared parameter types are converted to at compile time, only
+	// arguments of unknown type go through the conversion intrinsics
+	struct ptrs_astlist *curr = args;
+	for(int i = 0; i < narg; i++)
+	{
+		ptrs_jit_var_t val;
+		if(curr->entry == NULL)
+		{
+			val.val = jit_const_int(func, long, 0);
+			val.meta = ptrs_jit_const_meta(func, PTRS_TYPE_UNDEFINED);
+			val.constType = PTRS_TYPE_UNDEFINED;
+		}
+		else
+		{
+			val = curr->entry->vtable->get(curr->entry, func, scope);
+		}
+
+		if(i >= prototype->paramCount)
+		{
+			_args[i] = nativeArgument(node, func, scope, val, &paramDef[i]);
+			curr = curr->next;
+			continue;
+		}
+
+		ptrs_nativetype_info_t *type = prototype->params[i];
+		paramDef[i] = type->jitType;
+
+		if(type->varType == PTRS_TYPE_INT)
+			_args[i] = jit_insn_convert(func, ptrs_jit_vartoi(func, val), type->jitType, 0);
+		else if(type->varType == PTRS_TYPE_FLOAT)
+			_args[i] = jit_insn_convert(func, ptrs_jit_vartof(func, val), type->jitType, 0);
+		else if(val.constType == PTRS_TYPE_FUNCTION)
+			_args[i] = functionToCallback(node, func, scope, val);
+		else
+			_args[i] = jit_insn_convert(func, val.val, jit_type_void_ptr, 0);
+
+		curr = curr->next;
+	}
+
+	ptrs_nativetype_info_t *retType = prototype->retType;
+	jit_abi_t abi = prototype->variadic ? jit_abi_vararg : jit_abi_cdecl;
+	jit_type_t signature = ptrs_jit_getSignature(abi,
+		retType == NULL ? jit_type_void : retType->jitType, paramDef, narg);
+
+	jit_value_t retVal = jit_insn_call_native(func, prototype->name, target,
+		signature, _args, narg, 0);
+
+	ptrs_jit_var_t ret;
+	if(retType == NULL)
+	{
+		ret.val = jit_const_long(func, long, 0);
+		ret.meta = ptrs_jit_const_meta(func, PTRS_TYPE_UNDEFINED);
+		ret.constType = PTRS_TYPE_UNDEFINED;
+	}
+	else
+	{
+		ret.val = ptrs_jit_normalizeForVar(func, retVal);
+		ret.meta = ptrs_jit_const_meta(func, retType->varType);
+		ret.constType = retType->varType;
+	}
+
+	return ret;
+}
+
 static size_t getParameterCount(ptrs_function_t *ast)
 {
 	size_t count = 0;
@@ -238,6 +419,10 @@ static void checkFunctionParameter(ptrs_ast_t *node, jit_function_t func, ptrs_s
 			param.val = ptrs_jit_reinterpretCast(func, param.val, jit_type_long);
 		}
 
+		// the custom ABI passes float parameters as float64
+		if(curr->typing.meta.type == PTRS_TYPE_FLOAT)
+			param.val = ptrs_jit_reinterpretCast(func, param.val, jit_type_float64);
+
 		if(args != NULL)
 			args[i] = param;
 		else
@@ -457,14 +642,12 @@ static ptrs_jit_var_t callWithCustomAbi(jit_function_t func, jit_function_t unch
 	else
 	{
 		jit_type_t retType = getCustomAbiReturnType(ast);
-		jit_type_t signature = jit_type_create_signature(jit_abi_cdecl, retType, typeDef, customAbiArgCount, 0);
+		jit_type_t signature = ptrs_jit_getSignature(jit_abi_cdecl, retType, typeDef, customAbiArgCount);
 
 		jit_value_t closure = jit_const_int(func, void_ptr, (uintptr_t)jit_function_to_closure(uncheckedCallee));
 
 		jitRet = jit_insn_call_nested_indirect(func, closure, calleeParentFrame, signature,
 			jitArgs, customAbiArgCount, callflags);
-
-		jit_type_free(signature);
 	}
 
 	return handleCustomAbiReturn(func, ast, jitRet);
@@ -546,11 +729,18 @@ jit_function_t ptrs_jit_createFunction(ptrs_ast_t *node, jit_function_t parent,
 	else
 		func = jit_function_create_nested(ptrs_jit_context, signature, parent);
 
-	if(ptrs_optimizationLevel == -1)
+	if(ptrs_optimizeLoops)
+		jit_function_set_optimization_level(func, 0);
+	else if(ptrs_optimizationLevel == -1)
 		jit_function_set_optimization_level(func, jit_function_get_max_optimization_level());
 	else
 		jit_function_set_optimization_level(func, ptrs_optimizationLevel);
 
+	// with --lazy --dump-jit every function, not only script functions, is dumped
+	// right before it is compiled
+	if(ptrs_dumpOnDemand)
+		jit_function_set_on_demand_compiler(func, compileOnDemand);
+
 	if(name != NULL)
 		jit_function_set_meta(func, PTRS_JIT_FUNCTIONMETA_NAME, (char *)name, NULL, 0);
 	if(node != NULL)
@@ -572,8 +762,7 @@ jit_function_t ptrs_jit_createFunctionFromAst(ptrs_ast_t *node, jit_function_t p
 	if(ast->vararg != NULL)
 		ptrs_error(ast->body, "Support for variadic argument functions is not implemented");
 
-	jit_type_t signature = jit_type_create_signature(jit_abi_cdecl,
-		retType, paramDef, count, 0);
+	jit_type_t signature = ptrs_jit_getSignature(jit_abi_cdecl, retType, paramDef, count);
 
 	jit_function_t func = ptrs_jit_createFunction(node, parent, signature, ast->name);
 	jit_function_set_meta(func, PTRS_JIT_FUNCTIONMETA_FUNCAST, ast, NULL, 0);
@@ -584,27 +773,30 @@ jit_function_t ptrs_jit_createFunctionFromAst(ptrs_ast_t *node, jit_function_t p
 	return func;
 }
 
-void *ptrs_jit_createCallback(ptrs_ast_t *node, jit_function_t func, ptrs_scope_t *scope, void *closure)
+static const char *getFunctionName(jit_function_t func)
 {
-	jit_function_t unchecked = jit_function_get_meta(func, PTRS_JIT_FUNCTIONMETA_UNCHECKED);
-	if(unchecked != NULL)
-		func = unchecked; // `func` is actually a type checking closure for `unchecked` 
+	const char *funcName = jit_function_get_meta(func, PTRS_JIT_FUNCTIONMETA_NAME);
+	return funcName == NULL ? "?" : funcName;
+}
 
-	void *callbackClosure = jit_function_get_meta(func, PTRS_JIT_FUNCTIONMETA_CALLBACK);
-	if(callbackClosure != NULL)
-		return callbackClosure;
+static ptrs_function_t *getCallbackAst(ptrs_ast_t *node, jit_function_t func)
+{
+	ptrs_function_t *ast = jit_function_get_meta(func, PTRS_JIT_FUNCTIONMETA_FUNCAST);
+	if(ast == NULL)
+		ptrs_error(node, "Cannot create callback for function %s, failed to get function AST",
+			getFunctionName(func));
 
-	char *funcName = jit_function_get_meta(func, PTRS_JIT_FUNCTIONMETA_NAME);
-	if(funcName == NULL)
-		funcName = "?";
+	return ast;
+}
 
+// returns NULL when compiling the callback failed
+static void *buildCallback(ptrs_ast_t *node, jit_function_t func, ptrs_function_t *ast, void **frame)
+{
+	const char *funcName = getFunctionName(func);
 	char callbackName[strlen(".callback") + strlen(funcName) + 1];
 	sprintf(callbackName, "%s.callback", funcName);
 
-	ptrs_function_t *ast = jit_function_get_meta(func, PTRS_JIT_FUNCTIONMETA_FUNCAST);
 	ptrs_funcparameter_t *curr;
-	if(ast == NULL)
-		ptrs_error(node, "Cannot create callback for function %s, failed to get function AST", funcName);
 
 	size_t argc = getParameterCount(ast);
 	jit_type_t argDef[argc];
@@ -628,12 +820,11 @@ void *ptrs_jit_createCallback(ptrs_ast_t *node, jit_function_t func, ptrs_scope_
 	else
 		callbackReturnType = jit_type_long;
 
-	jit_type_t callbackSignature = jit_type_create_signature(jit_abi_cdecl, callbackReturnType, argDef, argc, 0);
+	jit_type_t callbackSignature = ptrs_jit_getSignature(jit_abi_cdecl, callbackReturnType, argDef, argc);
 	jit_function_t callback = ptrs_jit_createFunction(node, NULL, callbackSignature, strdup(callbackName));
 
-	// TODO currently this is hardcoded to the root frame
 	jit_value_t parentFrame = jit_insn_load_relative(callback,
-		jit_const_int(callback, void_ptr, (uintptr_t)scope->rootFrame),
+		jit_const_int(callback, void_ptr, (uintptr_t)frame),
 		0, jit_type_void_ptr
 	);
 
@@ -681,14 +872,87 @@ void *ptrs_jit_createCallback(ptrs_ast_t *node, jit_function_t func, ptrs_scope_
 
 	jit_insn_return(callback, ret);
 
-	if(ptrs_compileAot && jit_function_compile(callback) == 0)
-		ptrs_error(node, "Failed compiling function %s", callbackName);
+	if(ptrs_compileAot && !ptrs_jit_compileFunction(callback))
+		return NULL;
+
+	return jit_function_to_closure(callback);
+}
+
+void *ptrs_jit_createCallback(ptrs_ast_t *node, jit_function_t func, ptrs_scope_t *scope, void *closure)
+{
+	jit_function_t unchecked = jit_function_get_meta(func, PTRS_JIT_FUNCTIONMETA_UNCHECKED);
+	if(unchecked != NULL)
+		func = unchecked; // `func` is actually a type checking closure for `unchecked` 
+
+	void *callbackClosure = jit_function_get_meta(func, PTRS_JIT_FUNCTIONMETA_CALLBACK);
+	if(callbackClosure != NULL)
+		return callbackClosure;
+
+	ptrs_function_t *ast = getCallbackAst(node, func);
+	callbackClosure = buildCallback(node, func, ast, scope->rootFrame);
+	if(callbackClosure == NULL)
+		ptrs_error(node, "Failed compiling function %s.callback", getFunctionName(func));
 
-	callbackClosure = jit_function_to_closure(callback);
 	jit_function_set_meta(func, PTRS_JIT_FUNCTIONMETA_CALLBACK, callbackClosure, NULL, 0);
 	return callbackClosure;
 }
 
+// trampolines of nested functions load their parent frame from a slot. Slots
+// are kept per function and keyed by the frame they are bound to, so passing
+// the same closure again (e.g. from a loop or a repeated call of the parent)
+// reuses the already compiled trampoline instead of building a new one
+struct ptrs_callbackslot
+{
+	void *frame;
+	void *callback;
+	struct ptrs_callbackslot *next;
+};
+
+void *ptrs_jit_getCallback(ptrs_ast_t *node, void *closure, void *parentFrame)
+{
+	jit_function_t func = jit_function_from_closure(ptrs_jit_context, closure);
+	if(func == NULL)
+		ptrs_error(node, "Cannot pass function %p as an argument to a native function, "
+			"it is not a PointerScript function", closure);
+
+	jit_function_t unchecked = jit_function_get_meta(func, PTRS_JIT_FUNCTIONMETA_UNCHECKED);
+	if(unchecked != NULL)
+		func = unchecked;
+
+	// ptrs_error does not return, so it must not be called while holding the builder
+	// lock. The lock also guards the pools against callbacks registered from multiple threads
+	ptrs_function_t *ast = getCallbackAst(node, func);
+	jit_context_build_start(ptrs_jit_context);
+
+	struct ptrs_callbackslot *pool = jit_function_get_meta(func, PTRS_JIT_FUNCTIONMETA_CALLBACKPOOL);
+	struct ptrs_callbackslot *curr = pool;
+	while(curr != NULL && curr->frame != parentFrame)
+		curr = curr->next;
+
+	if(curr == NULL)
+	{
+		curr = malloc(sizeof(struct ptrs_callbackslot));
+		if(curr == NULL)
+			abort();
+
+		curr->frame = parentFrame;
+		curr->callback = buildCallback(node, func, ast, &curr->frame);
+		if(curr->callback == NULL)
+		{
+			jit_context_build_end(ptrs_jit_context);
+			free(curr);
+			ptrs_error(node, "Failed compiling function %s.callback", getFunctionName(func));
+		}
+
+		curr->next = pool;
+		jit_function_set_meta(func, PTRS_JIT_FUNCTIONMETA_CALLBACKPOOL, curr, NULL, 0);
+	}
+
+	void *callback = curr->callback;
+	jit_context_build_end(ptrs_jit_context);
+	return callback;
+}
+
 void *ptrs_jit_function_to_closure(ptrs_ast_t *node, jit_function_t func)
 {
 	jit_function_t closureFunc = jit_function_get_meta(func, PTRS_JIT_FUNCTIONMETA_CLOSURE);
@@ -714,8 +978,8 @@ void *ptrs_jit_function_to_closure(ptrs_ast_t *node, jit_function_t func)
 		argDef[i * 2 + 1] = jit_type_long;
 		argDef[i * 2 + 2] = jit_type_ulong;
 	}
-	jit_type_t checkerSig = jit_type_create_signature(jit_abi_cdecl, ptrs_jit_getVarType(),
-		argDef, jitArgc, 0);
+	jit_type_t checkerSig = ptrs_jit_getSignature(jit_abi_cdecl, ptrs_jit_getVarType(),
+		argDef, jitArgc);
 
 	char checkerName[strlen(".checked") + strlen(ast->name) + 1];
 	sprintf(checkerName, "%s.checked", ast->name);
@@ -745,13 +1009,83 @@ void *ptrs_jit_function_to_closure(ptrs_ast_t *node, jit_function_t func)
 	jit_insn_default_return(checker);
 	ptrs_jit_placeAssertions(checker, &checkerScope);
 
-	if(ptrs_compileAot && jit_function_compile(checker) == 0)
+	if(ptrs_compileAot && !ptrs_jit_compileFunction(checker))
 		ptrs_error(node, "Failed compiling function %s", checkerName);
 
 	jit_function_set_meta(func, PTRS_JIT_FUNCTIONMETA_CLOSURE, checker, NULL, 0);
 	return jit_function_to_closure(checker);
 }
 
+void ptrs_jit_setLoopOptimization(jit_function_t func, ptrs_scope_t *scope)
+{
+	if(!ptrs_optimizeLoops || !scope->hasLoops)
+		return;
+
+	// functions containing loops are where the time is spent, they get the
+	// optimization level chosen on the command line while everything else
+	// stays at -O0. The level is fixed when the IR is built, functions are
+	// never recompiled
+	if(ptrs_optimizationLevel == -1)
+		jit_function_set_optimization_level(func, jit_function_get_max_optimization_level());
+	else
+		jit_function_set_optimization_level(func, ptrs_optimizationLevel);
+}
+
+bool ptrs_jit_compileFunction(jit_function_t func)
+{
+	if(!ptrs_compileStats)
+		return jit_function_compile(func) != 0;
+
+	struct timespec start;
+	struct timespec end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	bool success = jit_function_compile(func) != 0;
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	unsigned level = jit_function_get_optimization_level(func);
+	if(level >= PTRS_OPTIMIZATION_LEVELS)
+		level = PTRS_OPTIMIZATION_LEVELS - 1;
+
+	levelFunctionCount[level]++;
+	levelCompileTime[level] += (end.tv_sec - start.tv_sec) * 1000.0
+		+ (end.tv_nsec - start.tv_nsec) / 1000000.0;
+	return success;
+}
+
+void ptrs_jit_printCompileStats()
+{
+	fprintf(stderr, "Interned %u distinct signatures for %u call sites and functions\n",
+		signatureCount, signatureRequests);
+	for(int i = 0; i < PTRS_OPTIMIZATION_LEVELS; i++)
+	{
+		if(levelFunctionCount[i] == 0)
+			continue;
+
+		fprintf(stderr, "-O%d: compiled %u functions in %.3f ms\n",
+			i, levelFunctionCount[i], levelCompileTime[i]);
+	}
+}
+
+static int compileOnDemand(jit_function_t func)
+{
+	// the IR was already built by ptrs_jit_buildFunction, we only have to turn
+	// it into machine code right before the first call
+	if(ptrs_dumpOnDemand)
+	{
+		// compiling frees the IR, so --dump-jit has to print it now
+		if(ptrs_optimizationLevel != -1)
+			jit_function_optimize(func);
+
+		const char *name = jit_function_get_meta(func, PTRS_JIT_FUNCTIONMETA_NAME);
+		jit_dump_function(stdout, func, name);
+	}
+
+	if(!ptrs_jit_compileFunction(func))
+		return JIT_RESULT_COMPILE_ERROR;
+
+	return JIT_RESULT_OK;
+}
+
 void ptrs_jit_buildFunction(ptrs_ast_t *node, jit_function_t func, ptrs_scope_t *scope,
 	ptrs_function_t *ast, ptrs_struct_t *thisType)
 {
@@ -813,7 +1147,66 @@ void ptrs_jit_buildFunction(ptrs_ast_t *node, jit_function_t func, ptrs_scope_t
 	jit_insn_default_return(func);
 
 	ptrs_jit_placeAssertions(func, &funcScope);
+	ptrs_jit_setLoopOptimization(func, &funcScope);
 
-	if(ptrs_compileAot && jit_function_compile(func) == 0)
+	if(ptrs_compileLazy)
+		jit_function_set_on_demand_compiler(func, compileOnDemand);
+	else if(ptrs_compileAot && !ptrs_jit_compileFunction(func))
 		ptrs_error(node, "Failed compiling function %s", ast->name);
 }
+
+static ptrs_function_t *copyFunctionAst(ptrs_function_t *ast)
+{
+	ptrs_function_t *copy = malloc(sizeof(ptrs_function_t));
+	memcpy(copy, ast, sizeof(ptrs_function_t));
+
+	ptrs_funcparameter_t **next = &copy->args;
+	for(ptrs_funcparameter_t *curr = ast->args; curr != NULL; curr = curr->next)
+	{
+		*next = malloc(sizeof(ptrs_funcparameter_t));
+		memcpy(*next, curr, sizeof(ptrs_funcparameter_t));
+		next = &(*next)->next;
+	}
+	*next = NULL;
+
+	return copy;
+}
+
+void ptrs_jit_buildClone(ptrs_ast_t *node, jit_function_t parent, ptrs_scope_t *scope,
+	jit_function_t generic, ptrs_function_t *ast, struct ptrs_functionclone *clone)
+{
+	// callers get the parameter types of a function from its function AST. The body
+	// of the clone is built from the original AST with the parameter types of the
+	// clone swapped in, so both versions need their own copy for their callers
+	if(jit_function_get_meta(generic, PTRS_JIT_FUNCTIONMETA_FUNCAST) == ast)
+		jit_function_set_meta(generic, PTRS_JIT_FUNCTIONMETA_FUNCAST, copyFunctionAst(ast), NULL, 0);
+
+	size_t argc = getParameterCount(ast);
+	ptrs_typing_t typings[argc + 1];
+
+	ptrs_funcparameter_t *curr = ast->args;
+	for(int i = 0; curr != NULL; i++, curr = curr->next)
+	{
+		typings[i] = curr->typing;
+		if(clone->types[i] != PTRS_TYPE_DYNAMIC)
+		{
+			memset(&curr->typing.meta, 0, sizeof(ptrs_meta_t));
+			curr->typing.meta.type = clone->types[i];
+		}
+	}
+
+	// the body is analyzed again with the parameter types of the clone, this
+	// fails if a value of another type is assigned to one of the parameters
+	clone->symbol = NULL;
+	if(ptrs_flow_analyzeClone(ast, clone->types))
+	{
+		clone->symbol = ptrs_jit_createFunctionFromAst(node, parent, ast);
+		jit_function_set_meta(clone->symbol, PTRS_JIT_FUNCTIONMETA_FUNCAST, copyFunctionAst(ast), NULL, 0);
+
+		ptrs_jit_buildFunction(node, clone->symbol, scope, ast, NULL);
+	}
+
+	curr = ast->args;
+	for(int i = 0; curr != NULL; i++, curr = curr->next)
+		curr->typing = typings[i];
+}
@@ -4,6 +4,7 @@
 #include <stdbool.h>
 #include <string.h>
 #include <signal.h>
+#include <pthread.h>
 
 #ifdef _GNU_SOURCE
 #include <dlfcn.h>
@@ -13,6 +14,7 @@
 #include "../../parser/common.h"
 #include "../../parser/ast.h"
 #include "../include/error.h"
+#include "../include/call.h"
 #include "../include/conversion.h"
 #include "../include/run.h"
 
@@ -20,39 +22,97 @@ struct ptrs_assertion
 {
 	struct ptrs_assertion *next;
 	jit_label_t label;
+	uint32_t id;
 	size_t argCount;
 	jit_value_t args[];
 };
 
+// the position and message of every emitted assertion. The generated code only
+// passes the index into this table to the shared failure stub of a function
+struct ptrs_assertioninfo
+{
+	ptrs_ast_t *ast;
+	const char *text;
+};
+static struct ptrs_assertioninfo *assertionInfos = NULL;
+static uint32_t assertionCount = 0;
+static uint32_t assertionCapacity = 0;
+
 FILE *ptrs_errorfile = NULL;
 ptrs_ast_t *ptrs_lastAst = NULL;
 bool ptrs_enableExceptions = false;
 bool ptrs_enableSafety = true;
+__thread jmp_buf *ptrs_errorRecovery = NULL;
 
 extern jit_context_t ptrs_jit_context;
 
-void ptrs_getpos(ptrs_codepos_t *pos, const char *code, size_t index)
+struct ptrs_lineindex
+{
+	struct ptrs_lineindex *next;
+	const char *code;
+	size_t count;
+	size_t lines[]; //offsets of the line starts
+};
+static struct ptrs_lineindex *lineIndices = NULL;
+static pthread_mutex_t lineIndexLock = PTHREAD_MUTEX_INITIALIZER;
+
+static struct ptrs_lineindex *getLineIndex(const char *code)
 {
-	int line = 1;
-	int column = 1;
-	const char *currLine = code;
-	for(int i = 0; i < index; i++)
+	pthread_mutex_lock(&lineIndexLock);
+
+	struct ptrs_lineindex *index = lineIndices;
+	while(index != NULL && index->code != code)
+		index = index->next;
+
+	if(index == NULL)
 	{
-		if(code[i] == '\n')
+		size_t count = 1;
+		for(const char *curr = code; *curr != 0; curr++)
 		{
-			line++;
-			column = 1;
-			currLine = &(code[i + 1]);
+			if(*curr == '\n')
+				count++;
 		}
-		else
+
+		index = malloc(sizeof(struct ptrs_lineindex) + count * sizeof(size_t));
+		index->code = code;
+		index->count = count;
+		index->lines[0] = 0;
+
+		size_t line = 1;
+		for(size_t i = 0; code[i] != 0; i++)
 		{
-			column++;
+			if(code[i] == '\n')
+				index->lines[line++] = i + 1;
 		}
+
+		index->next = lineIndices;
+		lineIndices = index;
 	}
 
-	pos->currLine = currLine;
-	pos->line = line;
-	pos->column = column;
+	pthread_mutex_unlock(&lineIndexLock);
+	return index;
+}
+
+void ptrs_getpos(ptrs_codepos_t *pos, const char *code, size_t index)
+{
+	// the line starts of each source file are indexed on first use, so
+	// positions can be looked up using a binary search
+	struct ptrs_lineindex *lineIndex = getLineIndex(code);
+
+	size_t low = 0;
+	size_t high = lineIndex->count - 1;
+	while(low < high)
+	{
+		size_t mid = low + (high - low + 1) / 2;
+		if(lineIndex->lines[mid] <= index)
+			low = mid;
+		else
+			high = mid - 1;
+	}
+
+	pos->currLine = code + lineIndex->lines[low];
+	pos->line = low + 1;
+	pos->column = index - lineIndex->lines[low] + 1;
 }
 
 void ptrs_printError(ptrs_error_t *error)
@@ -63,7 +123,7 @@ void ptrs_printError(ptrs_error_t *error)
 	{
 		fprintf(ptrs_errorfile, " at %s:%d:%d\n\n", error->file, error->pos.line, error->pos.column);
 
-		int linelen = strchr(error->pos.currLine, '\n') - error->pos.currLine;
+		int linelen = strcspn(error->pos.currLine, "\n");
 		fprintf(ptrs_errorfile, "%.*s\n", linelen, error->pos.currLine);
 
 		int linePos = (error->ast->code + error->ast->codepos) - error->pos.currLine;
@@ -75,10 +135,10 @@ void ptrs_printError(ptrs_error_t *error)
 		fprintf(ptrs_errorfile, "^\n");
 	}
 
-	fprintf(ptrs_errorfile, "\n%s", error->backtrace);
+	fprintf(ptrs_errorfile, "\n%s", ptrs_getBacktrace(error));
 }
 
-char *ptrs_backtrace(int traceSkip)
+static char *formatBacktrace(jit_stack_trace_t trace, int traceSkip)
 {
 	int bufflen = 1024;
 	char *buff = malloc(bufflen);
@@ -86,7 +146,6 @@ char *ptrs_backtrace(int traceSkip)
 	char *buffptr = buff;
 	buff[0] = 0;
 
-	jit_stack_trace_t trace = jit_exception_get_stack_trace();
 	int count = jit_stack_trace_get_size(trace);
 
 	for(int i = traceSkip; i < count; i++)
@@ -150,10 +209,34 @@ char *ptrs_backtrace(int traceSkip)
 		}
 	}
 
-	jit_stack_trace_free(trace);
 	return buff;
 }
 
+char *ptrs_getBacktrace(ptrs_error_t *error)
+{
+	// only the raw stack trace is captured when the error is created, formatting
+	// is deferred until the backtrace is printed or read by a catch statement
+	if(error->backtrace != NULL)
+		return error->backtrace;
+
+	static __thread bool hadError = false;
+	if(!hadError)
+	{
+		hadError = true;
+		error->backtrace = formatBacktrace(error->trace, error->traceSkip);
+		hadError = false;
+	}
+	else
+	{
+		error->backtrace = "<an error occured while obtaining the backtrace>\n";
+	}
+
+	jit_stack_trace_free(error->trace);
+	error->trace = NULL;
+	error->backtraceLen = strlen(error->backtrace) + 1;
+	return error->backtrace;
+}
+
 void *ptrs_formatErrorMsg(const char *msg, va_list ap)
 {
 	//special printf formats:
@@ -260,24 +343,20 @@ ptrs_error_t *ptrs_createError(ptrs_ast_t *ast, int skipTrace, const char *messa
 		ptrs_getpos(&error->pos, ast->code, ast->codepos);
 	}
 
-	static __thread bool hadError = false;
-	if(!hadError)
-	{
-		hadError = true;
-		error->backtrace = ptrs_backtrace(skipTrace);
-		hadError = false;
-	}
-	else
-	{
-		error->backtrace = "<an error occured while obtaining the backtrace>\n";
-	}
-
-	error->backtraceLen = strlen(error->backtrace) + 1;
+	error->trace = jit_exception_get_stack_trace();
+	error->traceSkip = skipTrace;
+	error->backtrace = NULL;
+	error->backtraceLen = 0;
 	return error;
 }
 
 static void _ptrs_verror(ptrs_ast_t *ast, int skipTrace, const char *msg, va_list ap)
 {
+	// used by threads parsing imports ahead of time, they silently drop the
+	// result and let the error be reported when the import is compiled
+	if(ptrs_errorRecovery != NULL)
+		longjmp(*ptrs_errorRecovery, 1);
+
 	msg = ptrs_formatErrorMsg(msg, ap);
 	ptrs_error_t *error = ptrs_createError(ast, skipTrace, msg, false);
 
@@ -302,7 +381,29 @@ void ptrs_error(ptrs_ast_t *ast, const char *msg, ...)
 {
 	va_list ap;
 	va_start(ap, msg);
-	_ptrs_verror(ast, 4, msg, ap);
+	_ptrs_verror(ast, 3, msg, ap);
+}
+
+static void assertionFailed(uint32_t id, ...)
+{
+	va_list ap;
+	va_start(ap, id);
+	_ptrs_verror(assertionInfos[id].ast, 3, assertionInfos[id].text, ap);
+}
+
+static uint32_t addAssertionInfo(ptrs_ast_t *ast, const char *text)
+{
+	if(assertionCount == assertionCapacity)
+	{
+		assertionCapacity = assertionCapacity == 0 ? 256 : assertionCapacity * 2;
+		assertionInfos = realloc(assertionInfos, assertionCapacity * sizeof(struct ptrs_assertioninfo));
+		if(assertionInfos == NULL)
+			abort();
+	}
+
+	assertionInfos[assertionCount].ast = ast;
+	assertionInfos[assertionCount].text = text;
+	return assertionCount++;
 }
 
 void ptrs_handle_sig(int sig, siginfo_t *info, void *data)
@@ -317,6 +418,7 @@ void ptrs_handle_sig(int sig, siginfo_t *info, void *data)
 		error->ast = ptrs_lastAst;
 		error->message = "";
 		error->backtrace = ""; //TODO
+		error->trace = NULL;
 
 		ptrs_getpos(&error->pos, ptrs_lastAst->code, ptrs_lastAst->codepos);
 
@@ -324,12 +426,12 @@ void ptrs_handle_sig(int sig, siginfo_t *info, void *data)
 		exit(EXIT_FAILURE);
 	}
 
-	_ptrs_error(NULL, 6, "Received signal: %s", strsignal(sig));
+	_ptrs_error(NULL, 5, "Received signal: %s", strsignal(sig));
 }
 
 void *ptrs_handle_exception(int type)
 {
-	_ptrs_error(NULL, 6, "JIT Exception: %d", type);
+	_ptrs_error(NULL, 5, "JIT Exception: %d", type);
 }
 
 void ptrs_handle_signals(jit_function_t func)
@@ -359,15 +461,12 @@ struct ptrs_assertion *ptrs_jit_vassert(ptrs_ast_t *ast, jit_function_t func, pt
 	if(!ptrs_enableSafety)
 		return NULL;
 
-	argCount += 2;
-
 	struct ptrs_assertion *assertion = malloc(sizeof(struct ptrs_assertion) + argCount * sizeof(jit_value_t));
 
+	assertion->id = addAssertionInfo(ast, text);
 	assertion->argCount = argCount;
-	assertion->args[0] = jit_const_int(func, void_ptr, (uintptr_t)ast);
-	assertion->args[1] = jit_const_int(func, void_ptr, (uintptr_t)text);
 
-	for(size_t i = 2; i < argCount; i++)
+	for(size_t i = 0; i < argCount; i++)
 		assertion->args[i] = va_arg(ap, jit_value_t);
 
 	va_end(ap);
@@ -448,24 +547,49 @@ ptrs_catcher_labels_t *ptrs_jit_addCatcher(ptrs_scope_t *scope)
 
 void ptrs_jit_placeAssertions(jit_function_t func, ptrs_scope_t *scope)
 {
+	// every failing assertion only stores its id and arguments and then jumps
+	// to a single call of assertionFailed shared by the whole function
+	size_t maxArgs = 0;
 	struct ptrs_assertion *curr = scope->firstAssertion;
-	while(curr != NULL)
+	for(; curr != NULL; curr = curr->next)
+	{
+		if(curr->argCount > maxArgs)
+			maxArgs = curr->argCount;
+	}
+
+	if(scope->firstAssertion != NULL)
 	{
-		jit_insn_label(func, &curr->label);
+		jit_value_t args[maxArgs + 1];
+		jit_type_t argDef[maxArgs + 1];
+		for(size_t i = 0; i <= maxArgs; i++)
+		{
+			argDef[i] = i == 0 ? jit_type_uint : jit_type_void_ptr;
+			args[i] = jit_value_create(func, argDef[i]);
+		}
+
+		jit_label_t failed = jit_label_undefined;
+		curr = scope->firstAssertion;
+		while(curr != NULL)
+		{
+			jit_insn_label(func, &curr->label);
 
-		jit_type_t *argDef = malloc(curr->argCount * sizeof(jit_type_t));
-		for(int i = 0; i < curr->argCount; i++)
-			argDef[i] = jit_type_void_ptr;
+			jit_insn_store(func, args[0], jit_const_int(func, uint, curr->id));
+			for(size_t i = 0; i < curr->argCount; i++)
+				jit_insn_store(func, args[i + 1], curr->args[i]);
 
-		jit_type_t signature = jit_type_create_signature(jit_abi_vararg, jit_type_void, argDef, curr->argCount, 1);
-		jit_insn_call_native(func, "ptrs_error", ptrs_error, signature, curr->args, curr->argCount, JIT_CALL_NORETURN);
+			struct ptrs_assertion *old = curr;
+			curr = curr->next;
+			free(old);
+
+			if(curr != NULL)
+				jit_insn_branch(func, &failed);
+		}
 
-		struct ptrs_assertion *old = curr;
-		curr = curr->next;
+		jit_insn_label(func, &failed);
 
-		jit_type_free(signature);
-		free(argDef);
-		free(old);
+		jit_type_t signature = ptrs_jit_getSignature(jit_abi_vararg, jit_type_void, argDef, maxArgs + 1);
+		jit_insn_call_native(func, "(assertion failed)", assertionFailed, signature,
+			args, maxArgs + 1, JIT_CALL_NORETURN);
 	}
 
 	if(scope->tryCatches != NULL)
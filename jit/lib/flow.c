@@ -1,5 +1,7 @@
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <inttypes.h>
 #include <string.h>
 
 #include "../../parser/ast.h"
@@ -14,21 +16,101 @@ typedef struct
 {
 	ptrs_val_t value;
 	ptrs_meta_t meta;
+	int64_t min; // range of values an int can have when knownRange is set
+	int64_t max;
 	uint8_t knownValue : 1;
 	uint8_t knownMeta : 1;
 	uint8_t knownType : 1;
 	uint8_t knownNativeType : 1;
+	uint8_t knownRange : 1;
 } ptrs_prediction_t;
 
-typedef struct ptrs_flowprediction
+typedef struct
 {
-	ptrs_jit_var_t *variable;
 	ptrs_prediction_t prediction;
-	uint8_t addressable : 1;
+	unsigned variable;
 	unsigned depth;
-	struct ptrs_flowprediction *next;
+	int next; // index of the next prediction for the same variable or -1
+	uint8_t addressable : 1;
+} ptrs_flowprediction_t;
+
+// predictions of a flow are stored in a flat array, with one chain of entries
+// per variable (one entry for each function depth the variable is used in).
+// Flows created by dupFlow share the same predictions until one of them is
+// modified (copy on write).
+typedef struct
+{
+	unsigned refCount;
+	unsigned count;
+	unsigned capacity;
+	unsigned variableCount;
+	int *heads; // first prediction for each variable index or -1
+	ptrs_flowprediction_t *entries;
 } ptrs_predictions_t;
 
+typedef struct
+{
+	ptrs_jit_var_t *variable;
+	ptrs_ast_t *allocation; // new expression the variable was defined with
+	unsigned depth;
+	bool escapes; // the value of the variable is used in a way that can make it outlive the function
+	uint8_t assignedTypes; // bit mask of the types of values assigned to the variable
+} ptrs_flowvariable_t;
+
+// assigns dense indices to all variables seen during one analysis
+typedef struct
+{
+	ptrs_flowvariable_t *variables;
+	unsigned count;
+	unsigned capacity;
+	ptrs_ast_t *nonEscapingUse;
+} ptrs_flowvariables_t;
+
+typedef struct
+{
+	uint8_t type; // type passed by all call sites with a known argument type
+	uint8_t conflicting : 1; // call sites pass arguments of different types
+	uint8_t unknown : 1; // at least one call site passes an argument of unknown type
+	uint8_t inferred : 1; // the parameter type was set by the flow analysis
+} ptrs_flowargument_t;
+
+// collects the arguments of all calls to script functions, functions which are
+// only called directly get their untyped parameters typed if all callers agree.
+// Otherwise a clone is created for each distinct set of known argument types.
+typedef struct
+{
+	struct ptrs_ast_function *function;
+	ptrs_flowargument_t *arguments;
+	unsigned argc;
+	uint8_t *signatures; // argc types for each clone to create
+	unsigned signatureCount;
+	bool called;
+	bool escapes; // the function is used as a value and can have unknown callers
+} ptrs_flowfunction_t;
+
+typedef struct
+{
+	ptrs_flowfunction_t *functions;
+	unsigned count;
+	unsigned capacity;
+	bool isModule; // top level functions can be called by importing scripts
+} ptrs_flowfunctions_t;
+
+// collects the index bases of the innermost loop currently analyzed, whose type
+// can be checked once before the loop when their variable is not changed inside it
+typedef struct
+{
+	ptrs_ast_t **bases; // identifiers of unknown type used as index base
+	unsigned baseCount;
+	unsigned baseCapacity;
+	ptrs_jit_var_t **assigned; // variables changed by the loop body
+	unsigned assignedCount;
+	unsigned assignedCapacity;
+	bool blocked; // the body contains loops, functions or try-catch and cannot be compiled twice
+} ptrs_flowloop_t;
+
+typedef struct ptrs_flowjumps ptrs_flowjumps_t;
+
 typedef struct
 {
 	bool dryRun;
@@ -36,14 +118,38 @@ typedef struct
 	bool inTryBlock;
 	unsigned depth;
 	ptrs_predictions_t *predictions;
+	ptrs_flowvariables_t *variables;
+	ptrs_flowfunctions_t *functions;
+	ptrs_flowloop_t *loop;
+	ptrs_flowjumps_t *jumps;
 	//...
 } ptrs_flow_t;
 
+// flows leaving the body of the innermost loop early. Breaks continue after the
+// loop, continues at the continue label (the step of for loops) or at the end of the body
+struct ptrs_flowjumps
+{
+	ptrs_flow_t breaks;
+	ptrs_flow_t continues;
+	bool hasBreaks;
+	bool hasContinues;
+};
+
+// number of fix point iterations over a loop body before predictions are widened
+#define PTRS_FLOW_LOOP_WIDEN 8
+
+// number of analysis runs verifying inferred parameter types before inference is abandoned
+#define PTRS_FLOW_INFERENCE_ROUNDS 4
+
+// maximum number of type specialized clones per function
+#define PTRS_FLOW_MAX_CLONES 4
+
 typedef struct
 {
 	ptrs_codepos_t pos;
 	ptrs_prediction_t prediction;
 	ptrs_ast_t *node;
+	bool boundsCheckRemoved;
 } ptrs_prediction_dump_t;
 
 static void analyzeExpression(ptrs_flow_t *flow, ptrs_ast_t *node, ptrs_prediction_t *ret);
@@ -54,7 +160,7 @@ static int preductionDumpOrder(ptrs_prediction_dump_t *a, ptrs_prediction_dump_t
 {
 	return b->pos.column - a->pos.column;
 }
-static void dumpPrediction(ptrs_ast_t *node, ptrs_prediction_t *pred)
+static void dumpPrediction(ptrs_ast_t *node, ptrs_prediction_t *pred, bool boundsCheckRemoved)
 {
 	static ptrs_prediction_dump_t dumps[64];
 	static size_t dumpCount = 0;
@@ -124,6 +230,12 @@ static void dumpPrediction(ptrs_ast_t *node, ptrs_prediction_t *pred)
 				printf(" type: %s", ptrs_typetoa(dumps[i].prediction.meta.type));
 			}
 
+			if(dumps[i].prediction.knownRange && !dumps[i].prediction.knownValue)
+				printf(" range: %"PRId64"..%"PRId64, dumps[i].prediction.min, dumps[i].prediction.max);
+
+			if(dumps[i].boundsCheckRemoved)
+				printf(" bounds check removed");
+
 			printf(" ast: %s\n", dumps[i].node->vtable->name);
 		}
 
@@ -140,7 +252,7 @@ static void dumpPrediction(ptrs_ast_t *node, ptrs_prediction_t *pred)
 			// this can happen for expressions placed in code after other expressions
 			// e.g. with step expressions of for statements.
 
-			if(pred->knownType || pred->knownMeta || pred->knownValue)
+			if(pred->knownType || pred->knownMeta || pred->knownValue || boundsCheckRemoved)
 			{
 				printf(">>>>>>>>>> prediction for previousely printed code in line %d:\n%.*s\n",
 					pos.line, end - pos.currLine, pos.currLine);
@@ -163,12 +275,13 @@ static void dumpPrediction(ptrs_ast_t *node, ptrs_prediction_t *pred)
 	if(dumpCount > sizeof(dumps) / sizeof(ptrs_prediction_dump_t))
 		return;
 
-	if(!pred->knownType && !pred->knownMeta && !pred->knownValue)
+	if(!pred->knownType && !pred->knownMeta && !pred->knownValue && !boundsCheckRemoved)
 		return;
 
 	memcpy(&dumps[dumpCount].prediction, pred, sizeof(ptrs_prediction_t));
 	memcpy(&dumps[dumpCount].pos, &pos, sizeof(ptrs_codepos_t));
 	dumps[dumpCount].node = node;
+	dumps[dumpCount].boundsCheckRemoved = boundsCheckRemoved;
 	dumpCount++;
 }
 
@@ -178,41 +291,418 @@ static inline void clearPrediction(ptrs_prediction_t *prediction)
 	prediction->knownValue = false;
 	prediction->knownMeta = false;
 	prediction->knownNativeType = false;
+	prediction->knownRange = false;
 }
 
-static void dupFlow(ptrs_flow_t *dest, ptrs_flow_t *src)
+// returns the range of values an int prediction can have
+static bool prediction2range(ptrs_prediction_t *prediction, int64_t *min, int64_t *max)
 {
-	memcpy(dest, src, sizeof(ptrs_flow_t)); // copy flags
-	dest->predictions = NULL;
+	if(!prediction->knownType || prediction->meta.type != PTRS_TYPE_INT)
+		return false;
 
-	ptrs_predictions_t **ptr = &dest->predictions;
-	ptrs_predictions_t *curr = src->predictions;
+	if(prediction->knownValue)
+	{
+		*min = prediction->value.intval;
+		*max = prediction->value.intval;
+		return true;
+	}
+	else if(prediction->knownRange)
+	{
+		*min = prediction->min;
+		*max = prediction->max;
+		return true;
+	}
 
-	while(curr != NULL)
+	return false;
+}
+
+static void setRange(ptrs_prediction_t *prediction, int64_t min, int64_t max)
+{
+	prediction->knownValue = false;
+	prediction->knownRange = min != INT64_MIN || max != INT64_MAX;
+	prediction->min = min;
+	prediction->max = max;
+}
+
+static bool addRange(int64_t a, int64_t b, int64_t *ret)
+{
+	if((b > 0 && a > INT64_MAX - b) || (b < 0 && a < INT64_MIN - b))
+		return false;
+
+	*ret = a + b;
+	return true;
+}
+
+static bool subRange(int64_t a, int64_t b, int64_t *ret)
+{
+	if((b < 0 && a > INT64_MAX + b) || (b > 0 && a < INT64_MIN + b))
+		return false;
+
+	*ret = a - b;
+	return true;
+}
+
+// has to be called before the other parts of the prediction are merged
+static void mergeRange(ptrs_prediction_t *dest, ptrs_prediction_t *src)
+{
+	int64_t min;
+	int64_t max;
+	int64_t srcMin;
+	int64_t srcMax;
+
+	if(prediction2range(dest, &min, &max) && prediction2range(src, &srcMin, &srcMax))
 	{
-		*ptr = malloc(sizeof(ptrs_predictions_t));
-		memcpy(*ptr, curr, sizeof(ptrs_predictions_t));
+		min = min < srcMin ? min : srcMin;
+		max = max > srcMax ? max : srcMax;
+		dest->knownRange = min != INT64_MIN || max != INT64_MAX;
+		dest->min = min;
+		dest->max = max;
+	}
+	else
+	{
+		dest->knownRange = false;
+	}
+}
 
-		curr = curr->next;
-		ptr = &((*ptr)->next);
+static unsigned getVariableIndex(ptrs_flow_t *flow, ptrs_jit_var_t *var)
+{
+	ptrs_flowvariables_t *vars = flow->variables;
+	unsigned index = var->flowIndex;
+
+	// the index stored in the variable might be left over from analyzing another script
+	if(index < vars->count && vars->variables[index].variable == var)
+		return index;
+
+	if(vars->count == vars->capacity)
+	{
+		vars->capacity = vars->capacity == 0 ? 64 : vars->capacity * 2;
+		vars->variables = realloc(vars->variables, vars->capacity * sizeof(ptrs_flowvariable_t));
 	}
+
+	index = vars->count++;
+	vars->variables[index].variable = var;
+	vars->variables[index].allocation = NULL;
+	vars->variables[index].depth = flow->depth;
+	vars->variables[index].escapes = false;
+	vars->variables[index].assignedTypes = 0;
+	var->flowIndex = index;
+	return index;
 }
 
-static void freePredictions(ptrs_predictions_t *curr)
+static void setAssigned(ptrs_flow_t *flow, ptrs_jit_var_t *var, ptrs_prediction_t *value)
 {
-	while(curr != NULL)
+	if(var == NULL)
+		return;
+
+	unsigned index = getVariableIndex(flow, var);
+	if(value->knownType)
+		flow->variables->variables[index].assignedTypes |= 1 << value->meta.type;
+	else
+		flow->variables->variables[index].assignedTypes = 0xFF;
+}
+
+static ptrs_flowfunction_t *getFunction(ptrs_flow_t *flow, struct ptrs_ast_function *func)
+{
+	ptrs_flowfunctions_t *funcs = flow->functions;
+	unsigned index = func->func.flowIndex;
+
+	if(index < funcs->count && funcs->functions[index].function == func)
+		return &funcs->functions[index];
+
+	if(funcs->count == funcs->capacity)
 	{
-		ptrs_predictions_t *next = curr->next;
-		free(curr);
-		curr = next;
+		funcs->capacity = funcs->capacity == 0 ? 16 : funcs->capacity * 2;
+		funcs->functions = realloc(funcs->functions, funcs->capacity * sizeof(ptrs_flowfunction_t));
 	}
+
+	unsigned argc = 0;
+	for(ptrs_funcparameter_t *curr = func->func.args; curr != NULL; curr = curr->next)
+		argc++;
+
+	index = funcs->count++;
+	ptrs_flowfunction_t *entry = &funcs->functions[index];
+	entry->function = func;
+	entry->argc = argc;
+	entry->arguments = calloc(argc, sizeof(ptrs_flowargument_t));
+	entry->signatures = NULL;
+	entry->signatureCount = 0;
+	entry->called = false;
+	entry->escapes = false;
+
+	for(unsigned i = 0; i < argc; i++)
+		entry->arguments[i].type = PTRS_TYPE_DYNAMIC;
+
+	func->func.flowIndex = index;
+	return entry;
+}
+
+static void freeFunctions(ptrs_flowfunctions_t *functions)
+{
+	for(unsigned i = 0; i < functions->count; i++)
+	{
+		free(functions->functions[i].arguments);
+		free(functions->functions[i].signatures);
+	}
+
+	free(functions->functions);
+}
+
+// parameters without type, default value and address can be typed by the flow analysis
+static bool isInferableParameter(ptrs_funcparameter_t *param)
+{
+	return param->typing.meta.type == PTRS_TYPE_DYNAMIC && param->typing.nativetype == NULL
+		&& param->argv == NULL && !param->arg.addressable;
+}
+
+static void addSignature(ptrs_flowfunction_t *entry, uint8_t *types)
+{
+	unsigned argc = entry->argc;
+	unsigned i;
+	for(i = 0; i < argc && types[i] == PTRS_TYPE_DYNAMIC; i++);
+	if(i == argc)
+		return;
+
+	for(i = 0; i < entry->signatureCount; i++)
+	{
+		if(memcmp(entry->signatures + i * argc, types, argc) == 0)
+			return;
+	}
+
+	if(entry->signatureCount == PTRS_FLOW_MAX_CLONES)
+		return;
+
+	if(entry->signatures == NULL)
+		entry->signatures = malloc(PTRS_FLOW_MAX_CLONES * argc);
+
+	memcpy(entry->signatures + entry->signatureCount * argc, types, argc);
+	entry->signatureCount++;
+}
+
+// returns the clone with the most fixed parameter types that matches the argument types
+static uint8_t findClone(struct ptrs_ast_function *func, uint8_t *types, unsigned argc)
+{
+	uint8_t best = 0;
+	unsigned bestScore = 0;
+
+	for(unsigned i = 0; i < func->cloneCount; i++)
+	{
+		uint8_t *cloneTypes = func->clones[i].types;
+		unsigned score = 0;
+		unsigned j;
+
+		for(j = 0; j < argc; j++)
+		{
+			if(cloneTypes[j] == PTRS_TYPE_DYNAMIC)
+				continue;
+			if(cloneTypes[j] != types[j])
+				break;
+			score++;
+		}
+
+		if(j == argc && score > bestScore)
+		{
+			best = i + 1;
+			bestScore = score;
+		}
+	}
+
+	return best;
+}
+
+static void addCallArgument(ptrs_flowargument_t *arg, ptrs_prediction_t *prediction)
+{
+	if(!prediction->knownType)
+		arg->unknown = true;
+	else if(arg->type == PTRS_TYPE_DYNAMIC)
+		arg->type = prediction->meta.type;
+	else if(arg->type != prediction->meta.type)
+		arg->conflicting = true;
+}
+
+static void setEscapes(ptrs_flow_t *flow, ptrs_jit_var_t *var)
+{
+	if(var == NULL)
+		return;
+
+	unsigned index = getVariableIndex(flow, var);
+	flow->variables->variables[index].escapes = true;
+}
+
+static void analyzeVariableUse(ptrs_flow_t *flow, ptrs_ast_t *node)
+{
+	ptrs_jit_var_t *var = node->arg.identifier.location;
+	if(var == NULL)
+		return;
+
+	unsigned index = getVariableIndex(flow, var);
+	ptrs_flowvariable_t *entry = &flow->variables->variables[index];
+	if(flow->variables->nonEscapingUse != node || entry->depth != flow->depth)
+		entry->escapes = true;
+}
+
+// analyzes an expression whose value is only accessed (e.g. the base of a member
+// expression) instead of being stored somewhere
+static void analyzeNonEscapingUse(ptrs_flow_t *flow, ptrs_ast_t *node, ptrs_prediction_t *ret)
+{
+	flow->variables->nonEscapingUse = node;
+	analyzeExpression(flow, node, ret);
+	flow->variables->nonEscapingUse = NULL;
+}
+
+// formatted strings which are only read (e.g. converted to a number) are dead
+// afterwards. Strings passed anywhere else, including native functions, might be
+// kept and are left alone
+static void analyzeReadString(ptrs_flow_t *flow, ptrs_ast_t *node, ptrs_prediction_t *ret)
+{
+	if(node->vtable == &ptrs_ast_vtable_stringformat)
+		analyzeNonEscapingUse(flow, node, ret);
+	else
+		analyzeExpression(flow, node, ret);
+}
+
+// structs without overloads and function members cannot leak their this pointer
+static bool canAllocateOnStack(ptrs_prediction_t *prediction)
+{
+	if(!prediction->knownType || !prediction->knownMeta || prediction->meta.type != PTRS_TYPE_STRUCT)
+		return false;
+
+	ptrs_struct_t *struc = ptrs_meta_getPointer(prediction->meta);
+	if(struc == NULL)
+		return false;
+
+	// the data initializer is added as an overload during compilation
+	for(struct ptrs_opoverload *curr = struc->overloads; curr != NULL; curr = curr->next)
+	{
+		if(curr->handler != NULL)
+			return false;
+	}
+
+	for(int i = 0; i < struc->memberCount; i++)
+	{
+		struct ptrs_structmember *curr = &struc->member[i];
+		if(curr->name != NULL && curr->type != PTRS_STRUCTMEMBER_VAR
+			&& curr->type != PTRS_STRUCTMEMBER_TYPED)
+			return false;
+	}
+
+	return true;
+}
+
+static void setAllocation(ptrs_flow_t *flow, ptrs_jit_var_t *var, ptrs_ast_t *value, ptrs_prediction_t *prediction)
+{
+	if(flow->dryRun || value == NULL || value->vtable != &ptrs_ast_vtable_new)
+		return;
+
+	struct ptrs_ast_new *expr = &value->arg.newexpr;
+	if(expr->onStack)
+		return;
+
+	if(expr->value->vtable != &ptrs_ast_vtable_identifier || !canAllocateOnStack(prediction))
+	{
+		setEscapes(flow, var);
+		return;
+	}
+
+	unsigned index = getVariableIndex(flow, var);
+	flow->variables->variables[index].allocation = value;
+}
+
+static int getFirstPrediction(ptrs_predictions_t *predictions, unsigned variable)
+{
+	if(predictions == NULL || variable >= predictions->variableCount)
+		return -1;
+	return predictions->heads[variable];
+}
+
+static void freePredictions(ptrs_predictions_t *predictions)
+{
+	if(predictions == NULL || --predictions->refCount > 0)
+		return;
+
+	free(predictions->heads);
+	free(predictions->entries);
+	free(predictions);
+}
+
+static ptrs_predictions_t *makeWritable(ptrs_flow_t *flow)
+{
+	ptrs_predictions_t *old = flow->predictions;
+	if(old != NULL && old->refCount == 1)
+		return old;
+
+	ptrs_predictions_t *predictions = malloc(sizeof(ptrs_predictions_t));
+	predictions->refCount = 1;
+	if(old == NULL)
+	{
+		predictions->count = 0;
+		predictions->capacity = 0;
+		predictions->variableCount = 0;
+		predictions->heads = NULL;
+		predictions->entries = NULL;
+	}
+	else
+	{
+		predictions->count = old->count;
+		predictions->capacity = old->count;
+		predictions->variableCount = old->variableCount;
+
+		predictions->heads = malloc(old->variableCount * sizeof(int));
+		memcpy(predictions->heads, old->heads, old->variableCount * sizeof(int));
+		predictions->entries = malloc(old->count * sizeof(ptrs_flowprediction_t));
+		memcpy(predictions->entries, old->entries, old->count * sizeof(ptrs_flowprediction_t));
+
+		old->refCount--;
+	}
+
+	flow->predictions = predictions;
+	return predictions;
+}
+
+static ptrs_flowprediction_t *addPrediction(ptrs_predictions_t *predictions, unsigned variable, unsigned depth)
+{
+	if(variable >= predictions->variableCount)
+	{
+		unsigned oldCount = predictions->variableCount;
+		predictions->variableCount = variable < 32 ? 64 : variable * 2;
+		predictions->heads = realloc(predictions->heads, predictions->variableCount * sizeof(int));
+		for(unsigned i = oldCount; i < predictions->variableCount; i++)
+			predictions->heads[i] = -1;
+	}
+
+	if(predictions->count == predictions->capacity)
+	{
+		predictions->capacity = predictions->capacity == 0 ? 64 : predictions->capacity * 2;
+		predictions->entries = realloc(predictions->entries,
+			predictions->capacity * sizeof(ptrs_flowprediction_t));
+	}
+
+	int index = predictions->count++;
+	ptrs_flowprediction_t *entry = &predictions->entries[index];
+	entry->variable = variable;
+	entry->depth = depth;
+	entry->next = -1;
+
+	// append to the end of the chain of this variable
+	int *ptr = &predictions->heads[variable];
+	while(*ptr != -1)
+		ptr = &predictions->entries[*ptr].next;
+	*ptr = index;
+
+	return entry;
+}
+
+static void dupFlow(ptrs_flow_t *dest, ptrs_flow_t *src)
+{
+	memcpy(dest, src, sizeof(ptrs_flow_t)); // copy flags
+	if(dest->predictions != NULL)
+		dest->predictions->refCount++;
 }
 
 static void mergePredictions(ptrs_flow_t *dest, ptrs_flow_t *srcFlow)
 {
 	ptrs_predictions_t *src = srcFlow->predictions;
 
-	if(dest == srcFlow || dest->predictions == src)
+	if(dest == srcFlow)
 		return;
 
 	if(dest->dryRun || srcFlow->dryRun)
@@ -228,170 +718,357 @@ static void mergePredictions(ptrs_flow_t *dest, ptrs_flow_t *srcFlow)
 		dest->endsInDead = srcFlow->endsInDead;
 		return;
 	}
-	if(srcFlow->endsInDead)
+	if(srcFlow->endsInDead || src == NULL)
 	{
 		freePredictions(src);
 		return;
 	}
 
-	while(src != NULL)
+	ptrs_predictions_t *predictions = makeWritable(dest);
+	for(unsigned i = 0; i < src->count; i++)
 	{
-		bool found = false;
-		ptrs_predictions_t *curr = dest->predictions;
-		while(curr != NULL)
-		{
-			if(curr->variable == src->variable && curr->depth == src->depth)
-			{
-				int8_t currType = curr->prediction.meta.type;
+		ptrs_flowprediction_t *srcEntry = &src->entries[i];
 
-				if(!curr->prediction.knownMeta || !src->prediction.knownMeta
-					|| memcmp(&curr->prediction.meta, &src->prediction.meta, sizeof(ptrs_meta_t)))
-				{
-					curr->prediction.knownMeta = false;
-					memset(&curr->prediction.meta, 0, sizeof(ptrs_meta_t));
-				}
+		int index = getFirstPrediction(predictions, srcEntry->variable);
+		while(index != -1 && predictions->entries[index].depth != srcEntry->depth)
+			index = predictions->entries[index].next;
 
-				if(!curr->prediction.knownType || !src->prediction.knownType
-					|| currType != src->prediction.meta.type)
-				{
-					curr->prediction.knownType = false;
-				}
-				else
-				{
-					curr->prediction.meta.type = currType;
-				}
+		if(index == -1)
+		{
+			ptrs_flowprediction_t *entry = addPrediction(predictions, srcEntry->variable, srcEntry->depth);
+			entry->prediction = srcEntry->prediction;
+			entry->addressable = srcEntry->addressable;
+			continue;
+		}
 
-				if(!curr->prediction.knownMeta || !src->prediction.knownMeta
-					|| memcmp(&curr->prediction.value, &src->prediction.value, sizeof(ptrs_val_t)))
-				{
-					curr->prediction.knownValue = false;
-					memset(&curr->prediction.value, 0, sizeof(ptrs_val_t));
-				}
+		if(srcEntry->addressable)
+			predictions->entries[index].addressable = true;
 
-				found = true;
-				break;
-			}
+		ptrs_prediction_t *curr = &predictions->entries[index].prediction;
+		ptrs_prediction_t *other = &srcEntry->prediction;
+		int8_t currType = curr->meta.type;
+		uint8_t currTypeIndex = curr->meta.array.typeIndex;
 
-			curr = curr->next;
+		mergeRange(curr, other);
+
+		if(!curr->knownMeta || !other->knownMeta
+			|| memcmp(&curr->meta, &other->meta, sizeof(ptrs_meta_t)))
+		{
+			curr->knownMeta = false;
+			memset(&curr->meta, 0, sizeof(ptrs_meta_t));
 		}
 
-		curr = src;
-		src = src->next;
+		if(!curr->knownType || !other->knownType
+			|| currType != other->meta.type)
+		{
+			curr->knownType = false;
+		}
+		else
+		{
+			curr->meta.type = currType;
+		}
 
-		if(found)
+		if(!curr->knownNativeType || !other->knownNativeType
+			|| currTypeIndex != other->meta.array.typeIndex)
 		{
-			free(curr);
+			curr->knownNativeType = false;
 		}
 		else
 		{
-			curr->next = dest->predictions;
-			dest->predictions = curr;
+			curr->meta.array.typeIndex = currTypeIndex;
+		}
+
+		if(!curr->knownMeta || !curr->knownValue || !other->knownValue
+			|| memcmp(&curr->value, &other->value, sizeof(ptrs_val_t)))
+		{
+			curr->knownValue = false;
+			memset(&curr->value, 0, sizeof(ptrs_val_t));
 		}
 	}
+
+	freePredictions(src);
+}
+
+// ends the flow at a break or continue, remembering its predictions for the jump target
+static void addJump(ptrs_flow_t *flow, ptrs_flow_t *target, bool *hasTarget)
+{
+	ptrs_flow_t jump;
+	dupFlow(&jump, flow);
+
+	if(*hasTarget)
+	{
+		mergePredictions(target, &jump);
+	}
+	else
+	{
+		memcpy(target, &jump, sizeof(ptrs_flow_t));
+		*hasTarget = true;
+	}
+
+	flow->endsInDead = true;
+}
+
+static void takeJumps(ptrs_flow_t *flow, ptrs_flow_t *jumps, bool *hasJumps)
+{
+	if(!*hasJumps)
+		return;
+
+	mergePredictions(flow, jumps);
+	*hasJumps = false;
+}
+
+static void dropJumps(ptrs_flowjumps_t *jumps)
+{
+	if(jumps->hasBreaks)
+		freePredictions(jumps->breaks.predictions);
+	if(jumps->hasContinues)
+		freePredictions(jumps->continues.predictions);
+
+	jumps->hasBreaks = false;
+	jumps->hasContinues = false;
 }
 
 static void clearAddressablePredictions(ptrs_flow_t *flow)
 {
-	if(flow->dryRun)
+	if(flow->dryRun || flow->predictions == NULL)
 		return;
 
-	ptrs_predictions_t *curr = flow->predictions;
-	while(curr != NULL)
+	ptrs_predictions_t *predictions = flow->predictions;
+	for(unsigned i = 0; i < predictions->count; i++)
 	{
-		if(curr->addressable)
-			clearPrediction(&curr->prediction);
+		ptrs_flowprediction_t *curr = &predictions->entries[i];
+		if(curr->addressable && (curr->prediction.knownType || curr->prediction.knownMeta
+			|| curr->prediction.knownValue || curr->prediction.knownNativeType))
+		{
+			predictions = makeWritable(flow);
+			clearPrediction(&predictions->entries[i].prediction);
+		}
+	}
+}
+static bool predictionEqual(ptrs_prediction_t *a, ptrs_prediction_t *b)
+{
+	if(a->knownType != b->knownType || a->knownMeta != b->knownMeta
+		|| a->knownValue != b->knownValue || a->knownNativeType != b->knownNativeType)
+		return false;
 
-		curr = curr->next;
+	if(a->knownType && a->meta.type != b->meta.type)
+		return false;
+	if(a->knownNativeType && a->meta.array.typeIndex != b->meta.array.typeIndex)
+		return false;
+	if(a->knownMeta && memcmp(&a->meta, &b->meta, sizeof(ptrs_meta_t)) != 0)
+		return false;
+	if(a->knownValue && memcmp(&a->value, &b->value, sizeof(ptrs_val_t)) != 0)
+		return false;
+
+	int64_t aMin, aMax, bMin, bMax;
+	bool aHasRange = prediction2range(a, &aMin, &aMax);
+	if(aHasRange != prediction2range(b, &bMin, &bMax))
+		return false;
+	if(aHasRange && (aMin != bMin || aMax != bMax))
+		return false;
+
+	return true;
+}
+
+// moves bounds of a range which changed in the last loop iteration to infinity,
+// so loop counters do not need an iteration for every value they can have
+static void widenRange(ptrs_prediction_t *curr, ptrs_prediction_t *old)
+{
+	int64_t min, max, oldMin, oldMax;
+	if(curr->knownValue || !prediction2range(curr, &min, &max) || !prediction2range(old, &oldMin, &oldMax))
+		return;
+
+	if(min < oldMin)
+		min = INT64_MIN;
+	if(max > oldMax)
+		max = INT64_MAX;
+	setRange(curr, min, max);
+}
+
+// compares the predictions of two flows, ignoring the order in which they were added.
+// Ranges of a which differ from the ones in b are widened, when widen is set
+// all predictions of a which differ are cleared
+static bool comparePredictions(ptrs_flow_t *a, ptrs_flow_t *b, bool widen)
+{
+	if(a->endsInDead != b->endsInDead)
+		return false;
+
+	ptrs_predictions_t *predictions = a->predictions;
+	ptrs_predictions_t *other = b->predictions;
+	if(predictions == other)
+		return true;
+
+	bool equal = (predictions == NULL ? 0 : predictions->count)
+		== (other == NULL ? 0 : other->count);
+	if(predictions == NULL)
+		return equal;
+
+	for(unsigned i = 0; i < predictions->count; i++)
+	{
+		ptrs_flowprediction_t *curr = &predictions->entries[i];
+
+		int index = getFirstPrediction(other, curr->variable);
+		while(index != -1 && other->entries[index].depth != curr->depth)
+			index = other->entries[index].next;
+
+		if(index != -1 && curr->addressable == other->entries[index].addressable
+			&& predictionEqual(&curr->prediction, &other->entries[index].prediction))
+			continue;
+
+		equal = false;
+		predictions = makeWritable(a);
+		curr = &predictions->entries[i];
+
+		if(widen)
+			clearPrediction(&curr->prediction);
+		else if(index != -1)
+			widenRange(&curr->prediction, &other->entries[index].prediction);
 	}
+
+	return equal;
 }
-static void setAddressable(ptrs_flow_t *flow, ptrs_jit_var_t *var)
+
+// marks all predictions of a variable in other depths than the current one as
+// addressable and returns the index of the prediction in the current depth
+static int findPrediction(ptrs_flow_t *flow, unsigned variable, bool markAll, bool *hasOther)
 {
-	ptrs_predictions_t *curr = flow->predictions;
+	ptrs_predictions_t *predictions = flow->predictions;
+	int found = -1;
 
-	while(curr != NULL)
+	int index = getFirstPrediction(predictions, variable);
+	while(index != -1)
 	{
-		if(curr->variable == var)
+		if(predictions->entries[index].depth == flow->depth && !markAll)
 		{
-			curr->addressable = true;
-			break;
+			found = index;
+		}
+		else
+		{
+			if(!predictions->entries[index].addressable)
+			{
+				predictions = makeWritable(flow);
+				predictions->entries[index].addressable = true;
+			}
+
+			if(hasOther != NULL)
+				*hasOther = true;
 		}
 
-		curr = curr->next;
+		index = predictions->entries[index].next;
 	}
+
+	return found;
 }
 
-static void setVariablePrediction(ptrs_flow_t *flow, ptrs_jit_var_t *var, ptrs_prediction_t *prediction)
+static void setAddressable(ptrs_flow_t *flow, ptrs_jit_var_t *var)
 {
-	bool newIsAddressable = false;
+	setEscapes(flow, var);
+	findPrediction(flow, getVariableIndex(flow, var), true, NULL);
+}
+
+static void addLoopAssignment(ptrs_flowloop_t *loop, ptrs_jit_var_t *var)
+{
+	for(unsigned i = 0; i < loop->assignedCount; i++)
+	{
+		if(loop->assigned[i] == var)
+			return;
+	}
 
-	ptrs_predictions_t *curr = flow->predictions;
-	if(curr == NULL)
+	if(loop->assignedCount == loop->assignedCapacity)
 	{
-		curr = malloc(sizeof(ptrs_predictions_t));
-		flow->predictions = curr;
+		loop->assignedCapacity = loop->assignedCapacity == 0 ? 16 : loop->assignedCapacity * 2;
+		loop->assigned = realloc(loop->assigned, loop->assignedCapacity * sizeof(ptrs_jit_var_t *));
+		if(loop->assigned == NULL)
+			abort();
 	}
-	else
+
+	loop->assigned[loop->assignedCount++] = var;
+}
+
+static void addLoopIndexBase(ptrs_flow_t *flow, ptrs_ast_t *base, ptrs_prediction_t *prediction)
+{
+	ptrs_flowloop_t *loop = flow->loop;
+	if(loop == NULL || flow->dryRun || base->vtable != &ptrs_ast_vtable_identifier)
+		return;
+
+	if(prediction->knownType
+		&& (prediction->meta.type != PTRS_TYPE_POINTER || prediction->knownNativeType))
+		return;
+
+	for(unsigned i = 0; i < loop->baseCount; i++)
 	{
-		ptrs_predictions_t *last;
-		while(curr != NULL)
+		if(loop->bases[i] == base)
+			return;
+	}
+
+	if(loop->baseCount == loop->baseCapacity)
+	{
+		loop->baseCapacity = loop->baseCapacity == 0 ? 8 : loop->baseCapacity * 2;
+		loop->bases = realloc(loop->bases, loop->baseCapacity * sizeof(ptrs_ast_t *));
+		if(loop->bases == NULL)
+			abort();
+	}
+
+	loop->bases[loop->baseCount++] = base;
+}
+
+static void setVariablePrediction(ptrs_flow_t *flow, ptrs_jit_var_t *var, ptrs_prediction_t *prediction)
+{
+	if(var == NULL)
+		return;
+
+	if(flow->loop != NULL)
+		addLoopAssignment(flow->loop, var);
+
+	// if a variable is used in multiple depths, e.g. by a function and a lambda defined
+	// inside of it, all predictions except the one of the current depth are marked addressable
+	bool newIsAddressable = false;
+	unsigned variable = getVariableIndex(flow, var);
+	int index = findPrediction(flow, variable, false, &newIsAddressable);
+	ptrs_predictions_t *predictions = makeWritable(flow);
+
+	if(index != -1)
+	{
+		ptrs_flowprediction_t *curr = &predictions->entries[index];
+		if(flow->inTryBlock)
 		{
-			if(curr->variable == var)
-			{
-				if(curr->depth != flow->depth)
-				{
-					curr->addressable = true;
-					newIsAddressable = true;
-					// we need a second prediction for this variable in the current depth
-					// we continue to search for it or create a new one, thus no return here.
-				}
-				else if(flow->inTryBlock)
-				{
-					// this instruction may or may not be executed depending on wether an
-					// exception was raised in the statements before
-					// e.g. after:
-					// 		var x = 0; try { someFunction(); x = "foo"; }
-					// x might either be an int or a string
-
-					if(curr->prediction.knownType != prediction->knownType
-						|| curr->prediction.meta.type != prediction->meta.type)
-						curr->prediction.knownType = false;
-
-					if(curr->prediction.knownMeta != prediction->knownMeta
-						|| memcmp(&curr->prediction.meta, &prediction->meta, sizeof(ptrs_meta_t)) != 0)
-						curr->prediction.knownMeta = false;
-
-					if(curr->prediction.knownValue != prediction->knownValue
-						|| memcmp(&curr->prediction.value, &prediction->value, sizeof(ptrs_val_t)) != 0)
-						curr->prediction.knownValue = false;
-				}
-				else if(flow->dryRun)
-				{
-					clearPrediction(&curr->prediction);
-					return;
-				}
-				else
-				{
-					memcpy(&curr->prediction, prediction, sizeof(ptrs_prediction_t));
-					return;
-				}
-			}
+			// this instruction may or may not be executed depending on wether an
+			// exception was raised in the statements before
+			// e.g. after:
+			// 		var x = 0; try { someFunction(); x = "foo"; }
+			// x might either be an int or a string
 
-			last = curr;
-			curr = curr->next;
+			mergeRange(&curr->prediction, prediction);
+
+			if(curr->prediction.knownType != prediction->knownType
+				|| curr->prediction.meta.type != prediction->meta.type)
+				curr->prediction.knownType = false;
+
+			if(curr->prediction.knownMeta != prediction->knownMeta
+				|| memcmp(&curr->prediction.meta, &prediction->meta, sizeof(ptrs_meta_t)) != 0)
+				curr->prediction.knownMeta = false;
+
+			if(curr->prediction.knownValue != prediction->knownValue
+				|| memcmp(&curr->prediction.value, &prediction->value, sizeof(ptrs_val_t)) != 0)
+				curr->prediction.knownValue = false;
+		}
+		else if(flow->dryRun)
+		{
+			clearPrediction(&curr->prediction);
 		}
-
-		last->next = malloc(sizeof(ptrs_predictions_t));
-		curr = last->next;
+		else
+		{
+			memcpy(&curr->prediction, prediction, sizeof(ptrs_prediction_t));
+		}
+		return;
 	}
 
+	ptrs_flowprediction_t *curr = addPrediction(predictions, variable, flow->depth);
 	if(flow->dryRun)
 		clearPrediction(&curr->prediction);
 	else
 		memcpy(&curr->prediction, prediction, sizeof(ptrs_prediction_t));
-	curr->variable = var;
 	curr->addressable = newIsAddressable;
-	curr->depth = flow->depth;
-	curr->next = NULL;
 }
 static void getVariablePrediction(ptrs_flow_t *flow, ptrs_jit_var_t *var, ptrs_prediction_t *ret)
 {
@@ -401,27 +1078,11 @@ static void getVariablePrediction(ptrs_flow_t *flow, ptrs_jit_var_t *var, ptrs_p
 		return;
 	}
 
-	ptrs_predictions_t *curr = flow->predictions;
-	while(curr != NULL)
-	{
-		if(curr->variable == var)
-		{
-			if(flow->depth != curr->depth)
-			{
-				curr->addressable = true;
-			}
-			else
-			{
-				memcpy(ret, &curr->prediction, sizeof(ptrs_prediction_t));
-				return;
-			}
-
-		}
-
-		curr = curr->next;
-	}
-
-	clearPrediction(ret);
+	int index = findPrediction(flow, getVariableIndex(flow, var), false, NULL);
+	if(index == -1)
+		clearPrediction(ret);
+	else
+		memcpy(ret, &flow->predictions->entries[index].prediction, sizeof(ptrs_prediction_t));
 }
 
 static void clearAddressablePredictionsIfOverloadExists(ptrs_flow_t *flow,
@@ -575,6 +1236,53 @@ static void analyzeList(ptrs_flow_t *flow, struct ptrs_astlist *list, ptrs_predi
 	}
 }
 
+static void analyzeCallArguments(ptrs_flow_t *flow, struct ptrs_ast_call *expr, ptrs_prediction_t *ret)
+{
+	struct ptrs_ast_function *callee = expr->value->arg.funcval;
+	struct ptrs_astlist *list = expr->arguments;
+	ptrs_funcparameter_t *param = callee->func.args;
+
+	unsigned argc = getFunction(flow, callee)->argc;
+	uint8_t types[argc + 1];
+
+	for(unsigned i = 0; list != NULL || i < argc; i++)
+	{
+		if(list != NULL)
+		{
+			analyzeExpression(flow, list->entry, ret);
+			list = list->next;
+		}
+		else
+		{
+			// missing arguments are passed as undefined
+			clearPrediction(ret);
+			ret->knownType = true;
+			ret->meta.type = PTRS_TYPE_UNDEFINED;
+		}
+
+		// analyzing the argument can add functions, so the entry is looked up every time
+		if(i < argc)
+		{
+			addCallArgument(&getFunction(flow, callee)->arguments[i], ret);
+
+			if(isInferableParameter(param) && ret->knownType
+				&& (ret->meta.type == PTRS_TYPE_INT || ret->meta.type == PTRS_TYPE_FLOAT))
+				types[i] = ret->meta.type;
+			else
+				types[i] = PTRS_TYPE_DYNAMIC;
+
+			param = param->next;
+		}
+	}
+
+	ptrs_flowfunction_t *entry = getFunction(flow, callee);
+	entry->called = true;
+
+	if(callee->func.vararg == NULL)
+		addSignature(entry, types);
+	expr->clone = findClone(callee, types, argc);
+}
+
 static void analyzeStatementList(ptrs_flow_t *flow, struct ptrs_astlist *list, ptrs_prediction_t *ret)
 {
 	while(list != NULL)
@@ -599,9 +1307,14 @@ static void analyzeFunction(ptrs_flow_t *outerFlow, ptrs_function_t *ast, ptrs_s
 		return;
 	}
 
+	if(outerFlow->loop != NULL)
+		outerFlow->loop->blocked = true;
+
 	ptrs_flow_t functionFlow;
 	dupFlow(&functionFlow, outerFlow);
 	functionFlow.depth++;
+	functionFlow.loop = NULL;
+	functionFlow.jumps = NULL;
 
 	clearAddressablePredictions(&functionFlow);
 	clearPrediction(&prediction);
@@ -649,6 +1362,9 @@ static void analyzeFunction(ptrs_flow_t *outerFlow, ptrs_function_t *ast, ptrs_s
 
 static void analyzeStruct(ptrs_flow_t *flow, ptrs_struct_t *struc, ptrs_prediction_t *ret)
 {
+	if(flow->loop != NULL)
+		flow->loop->blocked = true;
+
 	for(int i = 0; i < struc->memberCount; i++)
 	{
 		struct ptrs_structmember *curr = &struc->member[i];
@@ -678,12 +1394,21 @@ static void analyzeStruct(ptrs_flow_t *flow, ptrs_struct_t *struc, ptrs_predicti
 	ptrs_meta_setPointer(ret->meta, struc);
 }
 
+static bool isIndexInBounds(ptrs_flow_t *flow, ptrs_prediction_t *array, ptrs_prediction_t *index)
+{
+	int64_t min, max;
+	return !flow->dryRun && array->knownType && array->knownMeta && array->meta.type == PTRS_TYPE_POINTER
+		&& prediction2range(index, &min, &max) && min >= 0 && max < array->meta.array.size;
+}
+
 static void analyzeLValue(ptrs_flow_t *flow, ptrs_ast_t *node, ptrs_prediction_t *value)
 {
 	ptrs_prediction_t dummy;
 
 	if(node->vtable == &ptrs_ast_vtable_identifier)
 	{
+		setEscapes(flow, node->arg.varval);
+		setAssigned(flow, node->arg.varval, value);
 		setVariablePrediction(flow, node->arg.varval, value);
 	}
 	else if(node->vtable == &ptrs_ast_vtable_prefix_dereference)
@@ -694,13 +1419,19 @@ static void analyzeLValue(ptrs_flow_t *flow, ptrs_ast_t *node, ptrs_prediction_t
 	else if(node->vtable == &ptrs_ast_vtable_index)
 	{
 		struct ptrs_ast_binary *expr = &node->arg.binary;
+		ptrs_prediction_t index;
 		analyzeExpression(flow, expr->left, &dummy);
-		analyzeExpression(flow, expr->right, &dummy);
+		addLoopIndexBase(flow, expr->left, &dummy);
+		analyzeExpression(flow, expr->right, &index);
+
+		expr->setInBounds = isIndexInBounds(flow, &dummy, &index);
+		if(ptrs_dumpFlow && !flow->dryRun && expr->setInBounds)
+			dumpPrediction(node, value, true);
 	}
 	else if(node->vtable == &ptrs_ast_vtable_member)
 	{
 		struct ptrs_ast_member *expr = &node->arg.member;
-		analyzeExpression(flow, expr->base, &dummy);
+		analyzeNonEscapingUse(flow, expr->base, &dummy);
 		clearAddressablePredictionsIfOverloadExistsOrUnavailable(flow, &dummy, ptrs_assign_member);
 	}
 	else if(node->vtable == &ptrs_ast_vtable_importedsymbol)
@@ -876,6 +1607,73 @@ static void analyzeValueCheckCondition(ptrs_flow_t *flow, ptrs_ast_t *identifier
 	setVariablePrediction(flow, identifierExpr->location, &prediction);
 }
 
+static bool isSideEffectFree(ptrs_ast_t *node)
+{
+	return node->vtable == &ptrs_ast_vtable_constant
+		|| node->vtable == &ptrs_ast_vtable_identifier
+		|| (node->vtable == &ptrs_ast_vtable_prefix_sizeof
+			&& node->arg.astval->vtable == &ptrs_ast_vtable_identifier);
+}
+
+static void analyzeRangeCondition(ptrs_flow_t *flow, ptrs_ast_t *node, bool isElse)
+{
+	struct ptrs_ast_binary *expr = &node->arg.binary;
+	bool isUpperBound = node->vtable == &ptrs_ast_vtable_op_less
+		|| node->vtable == &ptrs_ast_vtable_op_lessequal;
+	bool isStrict = node->vtable == &ptrs_ast_vtable_op_less
+		|| node->vtable == &ptrs_ast_vtable_op_greater;
+
+	// !(x < y) is the same as x >= y
+	if(isElse)
+	{
+		isUpperBound = !isUpperBound;
+		isStrict = !isStrict;
+	}
+
+	ptrs_ast_t *identifier = expr->left;
+	ptrs_ast_t *value = expr->right;
+	if(identifier->vtable != &ptrs_ast_vtable_identifier)
+	{
+		identifier = expr->right;
+		value = expr->left;
+		isUpperBound = !isUpperBound;
+	}
+
+	if(identifier->vtable != &ptrs_ast_vtable_identifier || !isSideEffectFree(value))
+		return;
+
+	ptrs_prediction_t prediction;
+	ptrs_prediction_t valuePrediction;
+	int64_t min, max, valueMin, valueMax;
+
+	analyzeExpression(flow, value, &valuePrediction);
+	getVariablePrediction(flow, identifier->arg.identifier.location, &prediction);
+
+	if(!prediction.knownType || prediction.meta.type != PTRS_TYPE_INT || prediction.knownValue
+		|| !prediction2range(&valuePrediction, &valueMin, &valueMax))
+		return;
+
+	if(!prediction2range(&prediction, &min, &max))
+	{
+		min = INT64_MIN;
+		max = INT64_MAX;
+	}
+
+	if(isUpperBound && (!isStrict || subRange(valueMax, 1, &valueMax)) && valueMax < max)
+		max = valueMax;
+	else if(!isUpperBound && (!isStrict || addRange(valueMin, 1, &valueMin)) && valueMin > min)
+		min = valueMin;
+	else
+		return;
+
+	// the branch can never be executed
+	if(min > max)
+		return;
+
+	setRange(&prediction, min, max);
+	setVariablePrediction(flow, identifier->arg.identifier.location, &prediction);
+}
+
 static void analyzeCondition(ptrs_flow_t *flow, ptrs_ast_t *node, bool isElse)
 {
 	if(node->vtable == &ptrs_ast_vtable_prefix_logicnot)
@@ -908,14 +1706,41 @@ static void analyzeCondition(ptrs_flow_t *flow, ptrs_ast_t *node, bool isElse)
 			analyzeValueCheckCondition(flow, expr->right, expr->left);
 		}
 	}
-	else if(node->vtable == &ptrs_ast_vtable_op_logicand)
+	else if(node->vtable == &ptrs_ast_vtable_op_less
+		|| node->vtable == &ptrs_ast_vtable_op_lessequal
+		|| node->vtable == &ptrs_ast_vtable_op_greater
+		|| node->vtable == &ptrs_ast_vtable_op_greaterequal)
+	{
+		analyzeRangeCondition(flow, node, isElse);
+	}
+	else if((node->vtable == &ptrs_ast_vtable_op_logicand && !isElse)
+		|| (node->vtable == &ptrs_ast_vtable_op_logicor && isElse))
 	{
+		// (a && b) means both a and b are true, !(a || b) means both are false
 		struct ptrs_ast_binary *expr = &node->arg.binary;
 		analyzeCondition(flow, expr->left, isElse);
 		analyzeCondition(flow, expr->right, isElse);
 	}
 }
 
+static bool preservesRange(ptrs_ast_t *node)
+{
+	if(node->vtable == &ptrs_ast_vtable_identifier
+		|| node->vtable == &ptrs_ast_vtable_op_assign
+		|| node->vtable == &ptrs_ast_vtable_prefix_plus
+		|| node->vtable == &ptrs_ast_vtable_op_add
+		|| node->vtable == &ptrs_ast_vtable_op_sub)
+		return true;
+
+	for(int i = 0; i < sizeof(unaryIntFloatChangingHandler) / sizeof(struct unaryChangingHandler); i++)
+	{
+		if(node->vtable == unaryIntFloatChangingHandler[i].vtable)
+			return true;
+	}
+
+	return false;
+}
+
 static void analyzeExpression(ptrs_flow_t *flow, ptrs_ast_t *node, ptrs_prediction_t *ret)
 {
 	ptrs_prediction_t dummy;
@@ -936,6 +1761,7 @@ static void analyzeExpression(ptrs_flow_t *flow, ptrs_ast_t *node, ptrs_predicti
 	{
 		struct ptrs_ast_identifier *expr = &node->arg.identifier;
 
+		analyzeVariableUse(flow, node);
 		getVariablePrediction(flow, expr->location, ret);
 
 		if(!flow->dryRun)
@@ -989,6 +1815,9 @@ static void analyzeExpression(ptrs_flow_t *flow, ptrs_ast_t *node, ptrs_predicti
 	}
 	else if(node->vtable == &ptrs_ast_vtable_functionidentifier)
 	{
+		if(flow->variables->nonEscapingUse != node)
+			getFunction(flow, node->arg.funcval)->escapes = true;
+
 		ret->knownValue = true;
 		ret->knownType = true;
 		ret->value.ptrval = &node->arg.funcval->func;
@@ -1038,9 +1867,27 @@ static void analyzeExpression(ptrs_flow_t *flow, ptrs_ast_t *node, ptrs_predicti
 	else if(node->vtable == &ptrs_ast_vtable_call)
 	{
 		struct ptrs_ast_call *expr = &node->arg.call;
-		analyzeExpression(flow, expr->value, ret);
+		bool isDirectCall = expr->value->vtable == &ptrs_ast_vtable_functionidentifier;
 
-		analyzeList(flow, expr->arguments, &dummy);
+		if(isDirectCall)
+			analyzeNonEscapingUse(flow, expr->value, ret);
+		else
+			analyzeExpression(flow, expr->value, ret);
+
+		// member functions get the instance as this
+		if(expr->value->vtable == &ptrs_ast_vtable_member
+			&& expr->value->arg.member.base->vtable == &ptrs_ast_vtable_identifier)
+			setEscapes(flow, expr->value->arg.member.base->arg.identifier.location);
+
+		if(isDirectCall && !flow->dryRun)
+		{
+			analyzeCallArguments(flow, expr, &dummy);
+		}
+		else
+		{
+			analyzeList(flow, expr->arguments, &dummy);
+			expr->clone = 0;
+		}
 
 		if(ret->knownType && ret->meta.type == PTRS_TYPE_POINTER)
 		{
@@ -1050,7 +1897,15 @@ static void analyzeExpression(ptrs_flow_t *flow, ptrs_ast_t *node, ptrs_predicti
 
 			memset(&ret->meta, 0, sizeof(ptrs_meta_t));
 
-			if(expr->typing.nativetype != NULL)
+			struct ptrs_nativeprototype *prototype = NULL;
+			if(expr->value->vtable == &ptrs_ast_vtable_importedsymbol)
+				prototype = expr->value->arg.importedsymbol.prototype;
+
+			if(prototype != NULL && prototype->retType == NULL)
+				ret->meta.type = PTRS_TYPE_UNDEFINED;
+			else if(prototype != NULL)
+				ret->meta.type = prototype->retType->varType;
+			else if(expr->typing.nativetype != NULL)
 				ret->meta.type = expr->typing.nativetype->varType;
 			else if(expr->typing.meta.type != PTRS_TYPE_DYNAMIC)
 				memcpy(&ret->meta, &expr->typing.meta, sizeof(ptrs_meta_t));
@@ -1081,6 +1936,7 @@ static void analyzeExpression(ptrs_flow_t *flow, ptrs_ast_t *node, ptrs_predicti
 	else if(node->vtable == &ptrs_ast_vtable_stringformat)
 	{
 		struct ptrs_ast_strformat *expr = &node->arg.strformat;
+		expr->noEscape = flow->variables->nonEscapingUse == node;
 
 		struct ptrs_stringformat *curr = expr->insertions;
 		while(curr != NULL)
@@ -1126,7 +1982,7 @@ static void analyzeExpression(ptrs_flow_t *flow, ptrs_ast_t *node, ptrs_predicti
 	else if(node->vtable == &ptrs_ast_vtable_member)
 	{
 		struct ptrs_ast_member *expr = &node->arg.member;
-		analyzeExpression(flow, expr->base, ret);
+		analyzeNonEscapingUse(flow, expr->base, ret);
 
 		if(ret->knownType && ret->knownMeta
 			&& ret->meta.type == PTRS_TYPE_STRUCT)
@@ -1302,9 +2158,14 @@ static void analyzeExpression(ptrs_flow_t *flow, ptrs_ast_t *node, ptrs_predicti
 	{
 		struct ptrs_ast_binary *expr = &node->arg.binary;
 
-		analyzeExpression(flow, expr->left, ret);
+		analyzeReadString(flow, expr->left, ret);
+		addLoopIndexBase(flow, expr->left, ret);
 		analyzeExpression(flow, expr->right, &dummy);
 
+		// when the index is also assigned to, analyzeLValue will determine setInBounds
+		expr->getInBounds = isIndexInBounds(flow, ret, &dummy);
+		expr->setInBounds = false;
+
 		if(ret->knownType && ret->knownNativeType && ret->meta.type == PTRS_TYPE_POINTER
 			&& ret->meta.array.typeIndex != PTRS_NATIVETYPE_INDEX_VAR)
 		{
@@ -1396,7 +2257,7 @@ static void analyzeExpression(ptrs_flow_t *flow, ptrs_ast_t *node, ptrs_predicti
 	else if(node->vtable == &ptrs_ast_vtable_toint)
 	{
 		struct ptrs_ast_cast *expr = &node->arg.cast;
-		analyzeExpression(flow, expr->value, ret);
+		analyzeReadString(flow, expr->value, ret);
 		if(!ret->knownType || ret->meta.type == PTRS_TYPE_STRUCT)
 			clearAddressablePredictions(flow); // TODO cast<int> overload
 
@@ -1419,7 +2280,7 @@ static void analyzeExpression(ptrs_flow_t *flow, ptrs_ast_t *node, ptrs_predicti
 	else if(node->vtable == &ptrs_ast_vtable_tofloat)
 	{
 		struct ptrs_ast_cast *expr = &node->arg.cast;
-		analyzeExpression(flow, expr->value, ret);
+		analyzeReadString(flow, expr->value, ret);
 		if(!ret->knownType || ret->meta.type == PTRS_TYPE_STRUCT)
 			clearAddressablePredictions(flow); // TODO cast<int> overload
 
@@ -1748,6 +2609,10 @@ static void analyzeExpression(ptrs_flow_t *flow, ptrs_ast_t *node, ptrs_predicti
 				}
 				else if(ret->knownType && dummy.knownType)
 				{
+					int64_t leftMin, leftMax, rightMin, rightMax;
+					bool hasRange = prediction2range(ret, &leftMin, &leftMax)
+						&& prediction2range(&dummy, &rightMin, &rightMax);
+
 					const uint8_t *typeTable = binaryIntrinsicHandler[i].typeTable;
 					size_t comp = calc_typecomp(ret->meta.type, dummy.meta.type);
 					clearPrediction(ret);
@@ -1757,6 +2622,13 @@ static void analyzeExpression(ptrs_flow_t *flow, ptrs_ast_t *node, ptrs_predicti
 						ret->knownType = true;
 						ret->meta.type = typeTable[comp];
 					}
+
+					if(hasRange && node->vtable == &ptrs_ast_vtable_op_add
+						&& addRange(leftMin, rightMin, &leftMin) && addRange(leftMax, rightMax, &leftMax))
+						setRange(ret, leftMin, leftMax);
+					else if(hasRange && node->vtable == &ptrs_ast_vtable_op_sub
+						&& subRange(leftMin, rightMax, &leftMin) && subRange(leftMax, rightMin, &leftMax))
+						setRange(ret, leftMin, leftMax);
 				}
 				else
 				{
@@ -1803,6 +2675,28 @@ static void analyzeExpression(ptrs_flow_t *flow, ptrs_ast_t *node, ptrs_predicti
 				if(ret->knownType
 					&& (ret->meta.type == PTRS_TYPE_INT || ret->meta.type == PTRS_TYPE_FLOAT))
 				{
+					int64_t change = unaryIntFloatChangingHandler[i].change;
+					int64_t min, max;
+					ptrs_prediction_t updated;
+					memcpy(&updated, ret, sizeof(ptrs_prediction_t));
+					updated.knownValue = false;
+					updated.knownRange = false;
+
+					if(prediction2range(ret, &min, &max))
+					{
+						setRange(ret, min, max);
+						if(addRange(min, change, &min) && addRange(max, change, &max))
+							setRange(&updated, min, max);
+					}
+
+					// only update variables, analyzing other lvalues again would
+					// duplicate the side effects of their sub expressions
+					if(node->arg.astval->vtable == &ptrs_ast_vtable_identifier)
+						analyzeLValue(flow, node->arg.astval, &updated);
+
+					if(!unaryIntFloatChangingHandler[i].isSuffix)
+						memcpy(ret, &updated, sizeof(ptrs_prediction_t));
+
 					ret->knownValue = false;
 					foundOp = true;
 					break;
@@ -1822,8 +2716,16 @@ static void analyzeExpression(ptrs_flow_t *flow, ptrs_ast_t *node, ptrs_predicti
 			ptrs_error(node, "Cannot analyze expression");
 	}
 
+	// only a few expressions compute ranges, make sure no other expression
+	// passes on the range of one of its operands
+	if(ret->knownRange && !preservesRange(node))
+		ret->knownRange = false;
+
 	if(ptrs_dumpFlow && !flow->dryRun)
-		dumpPrediction(node, ret);
+	{
+		bool boundsCheckRemoved = node->vtable == &ptrs_ast_vtable_index && node->arg.binary.getInBounds;
+		dumpPrediction(node, ret, boundsCheckRemoved);
+	}
 }
 
 static void analyzeStatement(ptrs_flow_t *flow, ptrs_ast_t *node, ptrs_prediction_t *ret)
@@ -1848,6 +2750,7 @@ static void analyzeStatement(ptrs_flow_t *flow, ptrs_ast_t *node, ptrs_predictio
 		analyzeExpression(flow, stmt->value, ret);
 
 		setVariablePrediction(flow, &stmt->location, ret);
+		setAllocation(flow, &stmt->location, stmt->value, ret);
 	}
 	else if(node->vtable == &ptrs_ast_vtable_array)
 	{
@@ -1886,17 +2789,30 @@ static void analyzeStatement(ptrs_flow_t *flow, ptrs_ast_t *node, ptrs_predictio
 	}
 	else if(node->vtable == &ptrs_ast_vtable_delete)
 	{
-		analyzeExpression(flow, node->arg.astval, ret);
+		analyzeNonEscapingUse(flow, node->arg.astval, ret);
+	}
+	else if(node->vtable == &ptrs_ast_vtable_break)
+	{
+		// inside of try blocks the finally body runs first, those breaks are
+		// treated as falling through the rest of the loop body
+		if(flow->jumps != NULL && !flow->dryRun && !flow->inTryBlock)
+			addJump(flow, &flow->jumps->breaks, &flow->jumps->hasBreaks);
 	}
-	else if(node->vtable == &ptrs_ast_vtable_continue
-		|| node->vtable == &ptrs_ast_vtable_continue_label
-		|| node->vtable == &ptrs_ast_vtable_break)
+	else if(node->vtable == &ptrs_ast_vtable_continue)
 	{
-		//nothing
+		if(flow->jumps != NULL && !flow->dryRun && !flow->inTryBlock)
+			addJump(flow, &flow->jumps->continues, &flow->jumps->hasContinues);
+	}
+	else if(node->vtable == &ptrs_ast_vtable_continue_label)
+	{
+		if(flow->jumps != NULL && !flow->dryRun)
+			takeJumps(flow, &flow->jumps->continues, &flow->jumps->hasContinues);
 	}
 	else if(node->vtable == &ptrs_ast_vtable_trycatch)
 	{
 		struct ptrs_ast_trycatch *stmt = &node->arg.trycatch;
+		if(flow->loop != NULL)
+			flow->loop->blocked = true;
 
 		bool oldInTry = flow->inTryBlock;
 		flow->inTryBlock = true;
@@ -1950,6 +2866,9 @@ static void analyzeStatement(ptrs_flow_t *flow, ptrs_ast_t *node, ptrs_predictio
 	}
 	else if(node->vtable == &ptrs_ast_vtable_function)
 	{
+		if(flow->depth == 0 && flow->functions->isModule)
+			getFunction(flow, &node->arg.function)->escapes = true;
+
 		analyzeFunction(flow, &node->arg.function.func, NULL);
 	}
 	else if(node->vtable == &ptrs_ast_vtable_if)
@@ -1997,7 +2916,6 @@ static void analyzeStatement(ptrs_flow_t *flow, ptrs_ast_t *node, ptrs_predictio
 		int64_t value;
 		if(prediction2int(&dummy, &value))
 		{
-			ptrs_predictions_t *orginalPredictions = NULL;
 			bool orginalDryRun = flow->dryRun;
 			bool foundCase = false;
 
@@ -2023,54 +2941,131 @@ static void analyzeStatement(ptrs_flow_t *flow, ptrs_ast_t *node, ptrs_predictio
 
 			flow->dryRun = orginalDryRun;
 		}
+		else if(flow->dryRun)
+		{
+			analyzeStatement(flow, stmt->defaultCase, &dummy);
+
+			for(; curr != NULL; curr = curr->next)
+				analyzeStatement(flow, curr->body, ret);
+		}
 		else
 		{
+			// every case starts with the predictions from before the switch, as
+			// cases can end in a break the default case cannot be used for that
+			ptrs_flow_t start;
+			dupFlow(&start, flow);
+
 			analyzeStatement(flow, stmt->defaultCase, &dummy);
 
-			while(curr)
+			for(; curr != NULL; curr = curr->next)
 			{
-				ptrs_flow_t otherFlowVal;
-				ptrs_flow_t *otherFlow = flow;
-				if(!flow->dryRun)
-				{
-					dupFlow(&otherFlowVal, flow);
-					otherFlow = &otherFlowVal;
-				}
+				ptrs_flow_t caseFlow;
+				dupFlow(&caseFlow, &start);
 
-				analyzeStatement(flow, curr->body, ret);
-				mergePredictions(flow, otherFlow);
-
-				curr = curr->next;
+				analyzeStatement(&caseFlow, curr->body, ret);
+				mergePredictions(flow, &caseFlow);
 			}
+
+			freePredictions(start.predictions);
 		}
 	}
 	else if(node->vtable == &ptrs_ast_vtable_loop)
 	{
-		ptrs_ast_t *body = node->arg.astval;
+		struct ptrs_ast_loop *stmt = &node->arg.loop;
+		ptrs_ast_t *body = stmt->body;
+
+		if(flow->loop != NULL)
+			flow->loop->blocked = true;
+
 		if(flow->dryRun)
 		{
 			analyzeStatement(flow, body, &dummy);
 		}
 		else
 		{
-			ptrs_flow_t other;
+			// iterate until the predictions at the start of the loop body do not change
+			// anymore. Predictions only ever get less precise when merging, ranges are
+			// widened in every iteration and after PTRS_FLOW_LOOP_WIDEN iterations all
+			// changing predictions are dropped so deeply nested loops cannot blow up
+			// compile times.
 			bool oldDump = ptrs_dumpFlow;
 			ptrs_dumpFlow = false;
 
-			dupFlow(&other, flow);
-			analyzeStatement(flow, body, &dummy);
-			mergePredictions(flow, &other);
+			ptrs_flow_t head;
+			ptrs_flow_t next;
+			dupFlow(&head, flow);
 
-			dupFlow(&other, flow);
-			analyzeStatement(flow, body, &dummy);
-			mergePredictions(flow, &other);
+			ptrs_flowloop_t loop;
+			memset(&loop, 0, sizeof(ptrs_flowloop_t));
 
-			ptrs_dumpFlow = oldDump;
-			dupFlow(&other, flow);
-			analyzeStatement(flow, body, &dummy);
-			mergePredictions(flow, &other);
+			ptrs_flowjumps_t jumps;
+			jumps.hasBreaks = false;
+			jumps.hasContinues = false;
+
+			for(int i = 0; ; i++)
+			{
+				loop.baseCount = 0;
+				loop.assignedCount = 0;
+				loop.blocked = false;
+				dropJumps(&jumps);
+
+				dupFlow(&next, &head);
+				next.loop = &loop;
+				next.jumps = &jumps;
+				analyzeStatement(&next, body, &dummy);
+				takeJumps(&next, &jumps.continues, &jumps.hasContinues);
+
+				ptrs_flow_t merged;
+				dupFlow(&merged, &head);
+				mergePredictions(&merged, &next);
+
+				bool fixPoint = comparePredictions(&merged, &head, i >= PTRS_FLOW_LOOP_WIDEN);
+				freePredictions(head.predictions);
+				memcpy(&head, &merged, sizeof(ptrs_flow_t));
+
+				// the body was analyzed starting at the fix point in this iteration,
+				// so all annotations written to the AST are valid now
+				if(fixPoint)
+					break;
+			}
+
+			freePredictions(flow->predictions);
+			memcpy(flow, &head, sizeof(ptrs_flow_t));
+			takeJumps(flow, &jumps.breaks, &jumps.hasBreaks);
+
+			// index bases of variables not changed in the loop are annotated, the loop
+			// is then compiled a second time with their types checked before it
+			free(stmt->invariantBases);
+			stmt->invariantBases = NULL;
+			stmt->invariantBaseCount = 0;
+			for(unsigned i = 0; !loop.blocked && i < loop.baseCount; i++)
+			{
+				ptrs_jit_var_t *location = loop.bases[i]->arg.identifier.location;
+
+				bool assigned = false;
+				for(unsigned j = 0; j < loop.assignedCount; j++)
+					assigned = assigned || loop.assigned[j] == location;
+
+				if(!assigned)
+					loop.bases[stmt->invariantBaseCount++] = loop.bases[i];
+			}
+
+			if(stmt->invariantBaseCount > 0)
+				stmt->invariantBases = loop.bases;
+			else
+				free(loop.bases);
+			free(loop.assigned);
 
-			/* TODO replace this by a fix point algorithm? */
+			ptrs_dumpFlow = oldDump;
+			if(ptrs_dumpFlow)
+			{
+				dupFlow(&next, flow);
+				next.loop = NULL;
+				next.jumps = &jumps;
+				analyzeStatement(&next, body, &dummy);
+				freePredictions(next.predictions);
+				dropJumps(&jumps);
+			}
 		}
 	}
 	else if(node->vtable == &ptrs_ast_vtable_forin_setup)
@@ -2086,6 +3081,9 @@ static void analyzeStatement(ptrs_flow_t *flow, ptrs_ast_t *node, ptrs_predictio
 	else if(node->vtable == &ptrs_ast_vtable_forin_step)
 	{
 		struct ptrs_ast_forin *stmt = node->arg.forinptr;
+		for(int i = 0; flow->loop != NULL && i < stmt->varcount; i++)
+			addLoopAssignment(flow->loop, &stmt->varsymbols[i]);
+
 		clearPrediction(&dummy);
 		dummy.knownType = true;
 		dummy.knownMeta = true;
@@ -2113,7 +3111,8 @@ static void analyzeStatement(ptrs_flow_t *flow, ptrs_ast_t *node, ptrs_predictio
 	}
 	else if(node->vtable == &ptrs_ast_vtable_exprstatement)
 	{
-		analyzeExpression(flow, node->arg.astval, ret);
+		// the value of an expression statement is discarded
+		analyzeNonEscapingUse(flow, node->arg.astval, ret);
 	}
 	else
 	{
@@ -2123,18 +3122,157 @@ static void analyzeStatement(ptrs_flow_t *flow, ptrs_ast_t *node, ptrs_predictio
 	if(ptrs_dumpFlow && !flow->dryRun)
 	{
 		clearPrediction(ret);
-		dumpPrediction(node, ret);
+		dumpPrediction(node, ret, false);
+	}
+}
+
+static bool canInferParameter(ptrs_funcparameter_t *param, ptrs_flowargument_t *arg)
+{
+	return param->argv == NULL && !param->arg.addressable && param->typing.nativetype == NULL
+		&& !arg->conflicting && (arg->type == PTRS_TYPE_INT || arg->type == PTRS_TYPE_FLOAT);
+}
+
+// types untyped parameters with the type passed by the call sites. Call sites
+// passing an argument of unknown type are ignored here, as the argument might
+// only be unknown because the parameter types are not known yet (e.g. recursion)
+static bool proposeParameterTypes(ptrs_flowfunctions_t *functions)
+{
+	bool changed = false;
+	for(unsigned i = 0; i < functions->count; i++)
+	{
+		ptrs_flowfunction_t *entry = &functions->functions[i];
+		if(!entry->called || entry->escapes)
+			continue;
+
+		ptrs_funcparameter_t *curr = entry->function->func.args;
+		for(unsigned j = 0; curr != NULL; j++, curr = curr->next)
+		{
+			ptrs_flowargument_t *arg = &entry->arguments[j];
+			if(!isInferableParameter(curr) || !canInferParameter(curr, arg))
+				continue;
+
+			memset(&curr->typing.meta, 0, sizeof(ptrs_meta_t));
+			curr->typing.meta.type = arg->type;
+			arg->inferred = true;
+			changed = true;
+		}
+	}
+
+	return changed;
+}
+
+// removes inferred parameter types which were not confirmed by all call sites
+// and assignments of the last analysis run
+static bool verifyParameterTypes(ptrs_flowfunctions_t *functions, ptrs_flowvariables_t *variables, bool giveUp)
+{
+	bool changed = false;
+	for(unsigned i = 0; i < functions->count; i++)
+	{
+		ptrs_flowfunction_t *entry = &functions->functions[i];
+		ptrs_funcparameter_t *curr = entry->function->func.args;
+		for(unsigned j = 0; curr != NULL; j++, curr = curr->next)
+		{
+			ptrs_flowargument_t *arg = &entry->arguments[j];
+			if(!arg->inferred)
+				continue;
+
+			uint8_t type = curr->typing.meta.type;
+			unsigned index = curr->arg.flowIndex;
+			bool valid = !giveUp && entry->called && !entry->escapes
+				&& !arg->unknown && arg->type == type && canInferParameter(curr, arg)
+				&& index < variables->count && variables->variables[index].variable == &curr->arg
+				&& (variables->variables[index].assignedTypes & ~(1 << type)) == 0;
+
+			if(!valid)
+			{
+				curr->typing.meta.type = PTRS_TYPE_DYNAMIC;
+				arg->inferred = false;
+				changed = true;
+			}
+		}
+	}
+
+	return changed;
+}
+
+static bool createClones(ptrs_flowfunctions_t *functions)
+{
+	bool created = false;
+	for(unsigned i = 0; i < functions->count; i++)
+	{
+		ptrs_flowfunction_t *entry = &functions->functions[i];
+		struct ptrs_ast_function *func = entry->function;
+		if(entry->signatureCount == 0)
+			continue;
+
+		func->clones = malloc(entry->signatureCount * sizeof(struct ptrs_functionclone));
+		func->cloneCount = entry->signatureCount;
+		for(unsigned j = 0; j < entry->signatureCount; j++)
+		{
+			func->clones[j].symbol = NULL;
+			func->clones[j].types = malloc(entry->argc);
+			memcpy(func->clones[j].types, entry->signatures + j * entry->argc, entry->argc);
+		}
+
+		created = true;
+	}
+
+	return created;
+}
+
+static void analyzeScript(ptrs_flow_t *flow, ptrs_flow_t *start, ptrs_ast_t *ast)
+{
+	ptrs_prediction_t ret;
+
+	// call sites and assignments are collected again in every run
+	ptrs_flowfunctions_t *functions = flow->functions;
+	for(unsigned i = 0; i < functions->count; i++)
+	{
+		ptrs_flowfunction_t *entry = &functions->functions[i];
+		entry->called = false;
+		entry->signatureCount = 0;
+
+		for(unsigned j = 0; j < entry->argc; j++)
+		{
+			entry->arguments[j].type = PTRS_TYPE_DYNAMIC;
+			entry->arguments[j].conflicting = false;
+			entry->arguments[j].unknown = false;
+		}
 	}
+
+	for(unsigned i = 0; i < flow->variables->count; i++)
+		flow->variables->variables[i].assignedTypes = 0;
+
+	freePredictions(flow->predictions);
+	dupFlow(flow, start);
+	flow->endsInDead = false;
+	analyzeStatement(flow, ast, &ret);
 }
 
-void ptrs_flow_analyze(ptrs_ast_t *ast)
+void ptrs_flow_analyze(ptrs_ast_t *ast, bool isModule)
 {
 	ptrs_prediction_t ret;
 
+	ptrs_flowvariables_t variables;
+	variables.variables = NULL;
+	variables.count = 0;
+	variables.capacity = 0;
+	variables.nonEscapingUse = NULL;
+
+	ptrs_flowfunctions_t functions;
+	functions.functions = NULL;
+	functions.count = 0;
+	functions.capacity = 0;
+	functions.isModule = isModule;
+
 	ptrs_flow_t flow;
 	flow.predictions = NULL;
+	flow.variables = &variables;
+	flow.functions = &functions;
 	flow.depth = 0;
 	flow.inTryBlock = false;
+	flow.loop = NULL;
+	flow.jumps = NULL;
 
 	// make a dry run first to set addressable for variables used accross functions
 	flow.dryRun = true;
@@ -2142,8 +3280,102 @@ void ptrs_flow_analyze(ptrs_ast_t *ast)
 	analyzeStatement(&flow, ast, &ret);
 
 	flow.dryRun = false;
+	ptrs_flow_t start;
+	dupFlow(&start, &flow);
+
+	// the script is analyzed again until all inferred parameter types are confirmed.
+	// Only the last run is dumped, its annotations are the ones left in the AST
+	bool dump = ptrs_dumpFlow;
+	ptrs_dumpFlow = false;
+
+	analyzeScript(&flow, &start, ast);
+	if(proposeParameterTypes(&functions))
+	{
+		for(int i = 1; ; i++)
+		{
+			analyzeScript(&flow, &start, ast);
+			if(!verifyParameterTypes(&functions, &variables, i >= PTRS_FLOW_INFERENCE_ROUNDS))
+				break;
+		}
+	}
+
+	// the call sites are annotated with the clones to call in another run
+	ptrs_dumpFlow = dump;
+	if(createClones(&functions) || ptrs_dumpFlow)
+		analyzeScript(&flow, &start, ast);
+
+	// allocations stored in variables which never escape the function can be
+	// placed on the stack
+	for(unsigned i = 0; i < variables.count; i++)
+	{
+		ptrs_flowvariable_t *curr = &variables.variables[i];
+		if(curr->allocation != NULL && !curr->escapes)
+		{
+			curr->allocation->arg.newexpr.noEscape = true;
+			curr->variable->onStack = true;
+		}
+	}
+
+	freePredictions(start.predictions);
+	freePredictions(flow.predictions);
+	free(variables.variables);
+	freeFunctions(&functions);
+}
+
+bool ptrs_flow_analyzeClone(ptrs_function_t *ast, uint8_t *types)
+{
+	ptrs_flowvariables_t variables;
+	variables.variables = NULL;
+	variables.count = 0;
+	variables.capacity = 0;
+	variables.nonEscapingUse = NULL;
+
+	ptrs_flowfunctions_t functions;
+	functions.functions = NULL;
+	functions.count = 0;
+	functions.capacity = 0;
+	functions.isModule = false;
+
+	ptrs_flow_t flow;
+	flow.predictions = NULL;
+	flow.variables = &variables;
+	flow.functions = &functions;
+	flow.depth = 0;
+	flow.inTryBlock = false;
+	flow.loop = NULL;
+	flow.jumps = NULL;
 	flow.endsInDead = false;
-	analyzeStatement(&flow, ast, &ret);
+
+	bool dump = ptrs_dumpFlow;
+	ptrs_dumpFlow = false;
+
+	flow.dryRun = true;
+	analyzeFunction(&flow, ast, NULL);
+
+	for(unsigned i = 0; i < variables.count; i++)
+		variables.variables[i].assignedTypes = 0;
+
+	flow.dryRun = false;
+	analyzeFunction(&flow, ast, NULL);
+
+	ptrs_dumpFlow = dump;
+
+	// the clone cannot be compiled if a value of another type is assigned to a typed parameter
+	bool valid = true;
+	ptrs_funcparameter_t *curr = ast->args;
+	for(int i = 0; curr != NULL; i++, curr = curr->next)
+	{
+		if(types[i] == PTRS_TYPE_DYNAMIC)
+			continue;
+
+		unsigned index = curr->arg.flowIndex;
+		if(index >= variables.count || variables.variables[index].variable != &curr->arg
+			|| (variables.variables[index].assignedTypes & ~(1 << types[i])) != 0)
+			valid = false;
+	}
 
 	freePredictions(flow.predictions);
+	free(variables.variables);
+	freeFunctions(&functions);
+	return valid;
 }
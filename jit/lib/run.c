@@ -14,6 +14,7 @@
 
 jit_context_t ptrs_jit_context = NULL;
 bool ptrs_compileAot = true;
+bool ptrs_compileLazy = false;
 bool ptrs_analyzeFlow = true;
 
 void ptrs_compile(ptrs_result_t *result, char *src, const char *filename)
@@ -26,10 +27,11 @@ void ptrs_compile(ptrs_result_t *result, char *src, const char *filename)
 		ptrs_jit_context = jit_context_create();
 
 	result->symbols = NULL;
-	result->ast = ptrs_parse(src, filename, &result->symbols, true);
+	result->arena = ptrs_arena_create();
+	result->ast = ptrs_parse(src, filename, &result->symbols, result->arena, true);
 
 	if(ptrs_analyzeFlow)
-		ptrs_flow_analyze(result->ast);
+		ptrs_flow_analyze(result->ast, false);
 
 	jit_context_build_start(ptrs_jit_context);
 
@@ -49,8 +51,9 @@ void ptrs_compile(ptrs_result_t *result, char *src, const char *filename)
 	jit_insn_return(result->func, jit_const_long(result->func, long, EXIT_SUCCESS));
 
 	ptrs_jit_placeAssertions(result->func, &scope);
+	ptrs_jit_setLoopOptimization(result->func, &scope);
 
-	if(ptrs_compileAot && jit_function_compile(result->func) == 0)
+	if(ptrs_compileAot && !ptrs_jit_compileFunction(result->func))
 		ptrs_error(result->ast, "Failed compiling the root function");
 
 	jit_context_build_end(ptrs_jit_context);
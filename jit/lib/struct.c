@@ -13,6 +13,7 @@
 #include "../include/astlist.h"
 #include "../include/util.h"
 #include "../include/call.h"
+#include "../include/struct.h"
 
 struct ptrs_opoverload *ptrs_struct_getOverloadInfo(ptrs_struct_t *struc, void *handler, bool isInstance)
 {
@@ -133,6 +134,44 @@ struct ptrs_structmember *ptrs_struct_find(ptrs_struct_t *struc,
 	return ignored;
 }
 
+static struct ptrs_structmember *findCached(ptrs_structcache_t *cache, ptrs_struct_t *struc,
+	const char *key, uint32_t keyLen, enum ptrs_structmembertype exclude, ptrs_ast_t *ast)
+{
+	uint64_t meta = ptrs_const_pointerMeta(PTRS_TYPE_STRUCT, struc);
+	for(int i = 0; i < PTRS_STRUCT_CACHE_SIZE; i++)
+	{
+		if(cache->meta[i] == meta)
+			return cache->member[i];
+	}
+
+	// missing members are handled by overloads which are not cached
+	struct ptrs_structmember *member = ptrs_struct_find(struc, key, keyLen, exclude, ast);
+	if(member == NULL)
+		return NULL;
+
+	cache->meta[cache->next] = meta;
+	cache->member[cache->next] = member;
+	cache->next = (cache->next + 1) % PTRS_STRUCT_CACHE_SIZE;
+
+	if(member->type == PTRS_STRUCTMEMBER_VAR && !member->isStatic)
+	{
+		cache->varMeta = meta;
+		cache->varOffset = member->offset;
+	}
+
+	return member;
+}
+
+static ptrs_structcache_t *createCache()
+{
+	ptrs_structcache_t *cache = calloc(1, sizeof(ptrs_structcache_t));
+	if(cache == NULL)
+		abort();
+
+	cache->varMeta = ptrs_const_meta(PTRS_TYPE_DYNAMIC); // no value has this meta
+	return cache;
+}
+
 bool ptrs_struct_hasKey(void *data, ptrs_struct_t *struc,
 	const char *key, ptrs_meta_t keyMeta, ptrs_ast_t *ast)
 {
@@ -248,15 +287,9 @@ ptrs_var_t ptrs_struct_addressOfMember(ptrs_ast_t *ast, void *data, ptrs_struct_
 	return result;
 }
 
-ptrs_var_t ptrs_struct_get(ptrs_ast_t *ast, void *instance, ptrs_meta_t meta,
-	const char *key, uint32_t keyLen)
+static ptrs_var_t getFoundMember(ptrs_ast_t *ast, void *instance, ptrs_struct_t *struc,
+	struct ptrs_structmember *member, const char *key, uint32_t keyLen)
 {
-	if(meta.type != PTRS_TYPE_STRUCT)
-		ptrs_error(ast, "Cannot get property %s of a value of type %t", key, meta.type);
-	ptrs_struct_t *struc = ptrs_meta_getPointer(meta);
-
-	struct ptrs_structmember *member = ptrs_struct_find(struc, key, keyLen,
-		PTRS_STRUCTMEMBER_SETTER, ast);
 	if(member == NULL)
 	{
 		jit_function_t overload = ptrs_struct_getOverload(struc, ptrs_handle_member, instance != NULL);
@@ -275,6 +308,28 @@ ptrs_var_t ptrs_struct_get(ptrs_ast_t *ast, void *instance, ptrs_meta_t meta,
 
 	return ptrs_struct_getMember(ast, instance, struc, member);
 }
+ptrs_var_t ptrs_struct_get(ptrs_ast_t *ast, void *instance, ptrs_meta_t meta,
+	const char *key, uint32_t keyLen)
+{
+	if(meta.type != PTRS_TYPE_STRUCT)
+		ptrs_error(ast, "Cannot get property %s of a value of type %t", key, meta.type);
+	ptrs_struct_t *struc = ptrs_meta_getPointer(meta);
+
+	struct ptrs_structmember *member = ptrs_struct_find(struc, key, keyLen,
+		PTRS_STRUCTMEMBER_SETTER, ast);
+	return getFoundMember(ast, instance, struc, member, key, keyLen);
+}
+ptrs_var_t ptrs_struct_getCached(ptrs_ast_t *ast, void *instance, ptrs_meta_t meta,
+	const char *key, uint32_t keyLen, ptrs_structcache_t *cache)
+{
+	if(meta.type != PTRS_TYPE_STRUCT)
+		ptrs_error(ast, "Cannot get property %s of a value of type %t", key, meta.type);
+	ptrs_struct_t *struc = ptrs_meta_getPointer(meta);
+
+	struct ptrs_structmember *member = findCached(cache, struc, key, keyLen,
+		PTRS_STRUCTMEMBER_SETTER, ast);
+	return getFoundMember(ast, instance, struc, member, key, keyLen);
+}
 ptrs_jit_var_t ptrs_jit_struct_get(ptrs_ast_t *node, jit_function_t func, ptrs_scope_t *scope,
 	ptrs_jit_var_t base, jit_value_t keyVal, jit_value_t keyLen)
 {
@@ -364,6 +419,47 @@ ptrs_jit_var_t ptrs_jit_struct_get(ptrs_ast_t *node, jit_function_t func, ptrs_s
 				return result;
 		}
 	}
+	else if(jit_value_is_constant(keyVal) && jit_value_is_constant(keyLen))
+	{
+		ptrs_structcache_t *cache = createCache();
+		jit_value_t cacheVal = jit_const_int(func, void_ptr, (uintptr_t)cache);
+		jit_label_t slowPath = jit_label_undefined;
+		jit_label_t done = jit_label_undefined;
+
+		ptrs_jit_var_t result;
+		result.val = jit_value_create(func, jit_type_long);
+		result.meta = jit_value_create(func, jit_type_ulong);
+		result.constType = PTRS_TYPE_DYNAMIC;
+		result.addressable = false;
+
+		jit_value_t cachedMeta = jit_insn_load_relative(func, cacheVal,
+			offsetof(ptrs_structcache_t, varMeta), jit_type_ulong);
+		jit_insn_branch_if_not(func, jit_insn_eq(func, base.meta, cachedMeta), &slowPath);
+		jit_insn_branch_if_not(func, base.val, &slowPath);
+
+		jit_value_t offset = jit_insn_load_relative(func, cacheVal,
+			offsetof(ptrs_structcache_t, varOffset), jit_type_nuint);
+		jit_value_t addr = jit_insn_add(func, base.val, offset);
+		jit_insn_store(func, result.val, jit_insn_load_relative(func, addr, 0, jit_type_long));
+		jit_insn_store(func, result.meta,
+			jit_insn_load_relative(func, addr, sizeof(ptrs_val_t), jit_type_ulong));
+		jit_insn_branch(func, &done);
+
+		jit_insn_label(func, &slowPath);
+		jit_value_t ret;
+		jit_value_t astVal = jit_const_int(func, void_ptr, (uintptr_t)node);
+		ptrs_jit_reusableCall(func, ptrs_struct_getCached, ret, ptrs_jit_getVarType(),
+			(jit_type_void_ptr, jit_type_long, jit_type_ulong, jit_type_void_ptr, jit_type_int, jit_type_void_ptr),
+			(astVal, base.val, base.meta, keyVal, keyLen, cacheVal)
+		);
+
+		ptrs_jit_var_t slowResult = ptrs_jit_valToVar(func, ret);
+		jit_insn_store(func, result.val, slowResult.val);
+		jit_insn_store(func, result.meta, slowResult.meta);
+
+		jit_insn_label(func, &done);
+		return result;
+	}
 	else
 	{
 		jit_value_t ret;
@@ -377,15 +473,9 @@ ptrs_jit_var_t ptrs_jit_struct_get(ptrs_ast_t *node, jit_function_t func, ptrs_s
 	}
 }
 
-void ptrs_struct_set(ptrs_ast_t *ast, void *instance, ptrs_meta_t meta,
-	const char *key, uint32_t keyLen, ptrs_val_t val, ptrs_meta_t valMeta)
+static void setFoundMember(ptrs_ast_t *ast, void *instance, ptrs_struct_t *struc,
+	struct ptrs_structmember *member, const char *key, uint32_t keyLen, ptrs_val_t val, ptrs_meta_t valMeta)
 {
-	if(meta.type != PTRS_TYPE_STRUCT)
-		ptrs_error(ast, "Cannot set property %s of a value of type %t", key, meta.type);
-	ptrs_struct_t *struc = ptrs_meta_getPointer(meta);
-
-	struct ptrs_structmember *member = ptrs_struct_find(struc, key, keyLen,
-		PTRS_STRUCTMEMBER_GETTER, ast);
 	if(member == NULL)
 	{
 		jit_function_t overload = ptrs_struct_getOverload(struc, ptrs_assign_member, instance != NULL);
@@ -405,6 +495,28 @@ void ptrs_struct_set(ptrs_ast_t *ast, void *instance, ptrs_meta_t meta,
 
 	ptrs_struct_setMember(ast, instance, struc, member, val, valMeta);
 }
+void ptrs_struct_set(ptrs_ast_t *ast, void *instance, ptrs_meta_t meta,
+	const char *key, uint32_t keyLen, ptrs_val_t val, ptrs_meta_t valMeta)
+{
+	if(meta.type != PTRS_TYPE_STRUCT)
+		ptrs_error(ast, "Cannot set property %s of a value of type %t", key, meta.type);
+	ptrs_struct_t *struc = ptrs_meta_getPointer(meta);
+
+	struct ptrs_structmember *member = ptrs_struct_find(struc, key, keyLen,
+		PTRS_STRUCTMEMBER_GETTER, ast);
+	setFoundMember(ast, instance, struc, member, key, keyLen, val, valMeta);
+}
+void ptrs_struct_setCached(ptrs_ast_t *ast, void *instance, ptrs_meta_t meta,
+	const char *key, uint32_t keyLen, ptrs_val_t val, ptrs_meta_t valMeta, ptrs_structcache_t *cache)
+{
+	if(meta.type != PTRS_TYPE_STRUCT)
+		ptrs_error(ast, "Cannot set property %s of a value of type %t", key, meta.type);
+	ptrs_struct_t *struc = ptrs_meta_getPointer(meta);
+
+	struct ptrs_structmember *member = findCached(cache, struc, key, keyLen,
+		PTRS_STRUCTMEMBER_GETTER, ast);
+	setFoundMember(ast, instance, struc, member, key, keyLen, val, valMeta);
+}
 void ptrs_jit_struct_set(ptrs_ast_t *node, jit_function_t func, ptrs_scope_t *scope,
 	ptrs_jit_var_t base, jit_value_t keyVal, jit_value_t keyLen, ptrs_jit_var_t value)
 {
@@ -489,6 +601,51 @@ void ptrs_jit_struct_set(ptrs_ast_t *node, jit_function_t func, ptrs_scope_t *sc
 			ptrs_error(node, "Property %s of struct %s is not a valid lvalue", member->name, struc->name);
 		}
 	}
+	else if(jit_value_is_constant(keyVal) && jit_value_is_constant(keyLen))
+	{
+		ptrs_structcache_t *cache = createCache();
+		jit_value_t cacheVal = jit_const_int(func, void_ptr, (uintptr_t)cache);
+		jit_value_t val = ptrs_jit_reinterpretCast(func, value.val, jit_type_long);
+		jit_label_t slowPath = jit_label_undefined;
+		jit_label_t done = jit_label_undefined;
+
+		jit_value_t cachedMeta = jit_insn_load_relative(func, cacheVal,
+			offsetof(ptrs_structcache_t, varMeta), jit_type_ulong);
+		jit_insn_branch_if_not(func, jit_insn_eq(func, base.meta, cachedMeta), &slowPath);
+		jit_insn_branch_if_not(func, base.val, &slowPath);
+
+		jit_value_t offset = jit_insn_load_relative(func, cacheVal,
+			offsetof(ptrs_structcache_t, varOffset), jit_type_nuint);
+		jit_value_t addr = jit_insn_add(func, base.val, offset);
+		jit_insn_store_relative(func, addr, 0, val);
+		jit_insn_store_relative(func, addr, sizeof(ptrs_val_t), value.meta);
+		jit_insn_branch(func, &done);
+
+		jit_insn_label(func, &slowPath);
+		ptrs_jit_reusableCallVoid(func, ptrs_struct_setCached,
+			(
+				jit_type_void_ptr,
+				jit_type_long,
+				jit_type_ulong,
+				jit_type_void_ptr,
+				jit_type_int,
+				jit_type_long,
+				jit_type_ulong,
+				jit_type_void_ptr
+			), (
+				jit_const_int(func, void_ptr, (uintptr_t)node),
+				base.val,
+				base.meta,
+				keyVal,
+				keyLen,
+				val,
+				value.meta,
+				cacheVal
+			)
+		);
+
+		jit_insn_label(func, &done);
+	}
 	else
 	{
 		ptrs_jit_reusableCallVoid(func, ptrs_struct_set,
@@ -654,7 +811,7 @@ ptrs_jit_var_t ptrs_jit_struct_call(ptrs_ast_t *node, jit_function_t func, ptrs_
 }
 
 ptrs_jit_var_t ptrs_struct_construct(ptrs_ast_t *ast, jit_function_t func, ptrs_scope_t *scope,
-	ptrs_jit_var_t constructor, struct ptrs_astlist *arguments, bool allocateOnStack)
+	ptrs_jit_var_t constructor, struct ptrs_astlist *arguments, bool allocateOnStack, bool reuseStack)
 {
 	ptrs_jit_typeCheck(ast, func, scope, constructor, PTRS_TYPE_STRUCT,
 		"Value of type %t is not a constructor");
@@ -666,7 +823,7 @@ ptrs_jit_var_t ptrs_struct_construct(ptrs_ast_t *ast, jit_function_t func, ptrs_
 		ptrs_struct_t *struc = ptrs_meta_getPointer(meta);
 
 		jit_value_t size = jit_const_int(func, nuint, struc->size);
-		instance = ptrs_jit_allocate(func, size, allocateOnStack, false);
+		instance = ptrs_jit_allocate(func, size, allocateOnStack, reuseStack);
 
 		jit_function_t ctor = ptrs_struct_getOverload(struc, ptrs_handle_new, true);
 		if(ctor != NULL)
@@ -678,7 +835,7 @@ ptrs_jit_var_t ptrs_struct_construct(ptrs_ast_t *ast, jit_function_t func, ptrs_
 		jit_value_t size = jit_insn_load_relative(func, struc,
 			offsetof(ptrs_struct_t, size), jit_type_uint);
 
-		instance = ptrs_jit_allocate(func, size, allocateOnStack, false);
+		instance = ptrs_jit_allocate(func, size, allocateOnStack, reuseStack);
 
 		ptrs_jit_var_t ctor;
 		ptrs_jit_reusableCall(func, ptrs_struct_getOverloadClosure, ctor.val,
@@ -3,6 +3,10 @@
 #include <stdarg.h>
 #include <string.h>
 #include <assert.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <jit/jit.h>
 
 #include "../../parser/common.h"
@@ -13,22 +17,92 @@
 #include "../include/util.h"
 #include "jit/jit-value.h"
 
+static char *mapFile(int fd, size_t size)
+{
+	// the parser expects the source to be null terminated. The rest of the last
+	// page of a mapping is zero filled, when the file ends exactly at a page
+	// boundary an anonymous page is placed behind it.
+	size_t pageSize = sysconf(_SC_PAGESIZE);
+	size_t mapSize = (size / pageSize + 1) * pageSize;
+	char *content;
+
+	if(size % pageSize != 0)
+	{
+		content = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+		return content == MAP_FAILED ? NULL : content;
+	}
+
+#ifdef MAP_ANONYMOUS
+	content = mmap(NULL, mapSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if(content == MAP_FAILED)
+		return NULL;
+
+	if(mmap(content, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED)
+	{
+		munmap(content, mapSize);
+		return NULL;
+	}
+	return content;
+#else
+	return NULL;
+#endif
+}
+
+static char *readStream(int fd)
+{
+	size_t size = 0;
+	size_t capacity = 4096;
+	char *content = malloc(capacity);
+
+	for(;;)
+	{
+		if(size + 1 >= capacity)
+		{
+			capacity *= 2;
+			content = realloc(content, capacity);
+		}
+
+		ssize_t count = read(fd, content + size, capacity - size - 1);
+		if(count < 0)
+		{
+			free(content);
+			return NULL;
+		}
+		else if(count == 0)
+		{
+			break;
+		}
+
+		size += count;
+	}
+
+	content[size] = 0;
+	return content;
+}
+
 char *ptrs_readFile(const char *path)
 {
-	FILE *fd = fopen(path, "r");
+	// source buffers are referenced by the AST and error messages until exit,
+	// so they are never unmapped or freed
+	int fd;
+	if(strcmp(path, "-") == 0)
+		fd = dup(STDIN_FILENO);
+	else
+		fd = open(path, O_RDONLY);
 
-	if(fd == NULL)
+	if(fd < 0)
 		return NULL;
 
-	fseek(fd, 0, SEEK_END);
-	long fsize = ftell(fd);
-	fseek(fd, 0, SEEK_SET);
+	char *content = NULL;
+	struct stat info;
+	if(fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0)
+		content = mapFile(fd, info.st_size);
 
-	char *content = malloc(fsize + 1);
-	fread(content, fsize, 1, fd);
-	fclose(fd);
-	content[fsize] = 0;
+	// pipes, terminals and files that cannot be mapped are read into memory
+	if(content == NULL)
+		content = readStream(fd);
 
+	close(fd);
 	return content;
 }
 
@@ -9,6 +9,7 @@
 #include "../parser/common.h"
 #include "include/run.h"
 #include "include/error.h"
+#include "include/call.h"
 #include "include/conversion.h"
 
 static bool handleSignals = true;
@@ -18,6 +19,11 @@ static bool dumpOps = false;
 extern size_t ptrs_arraymax;
 extern bool ptrs_dumpFlow;
 extern int ptrs_optimizationLevel;
+extern bool ptrs_optimizeLoops;
+extern bool ptrs_compileStats;
+extern bool ptrs_dumpOnDemand;
+extern int ptrs_compileJobs;
+extern bool ptrs_parseStats;
 
 extern void ptrs_initialize_nativeTypes();
 
@@ -36,6 +42,11 @@ static struct option options[] = {
 	{"O1", no_argument, 0, 12},
 	{"O2", no_argument, 0, 13},
 	{"O3", no_argument, 0, 14},
+	{"lazy", no_argument, 0, 15},
+	{"optimize-loops", no_argument, 0, 16},
+	{"compile-stats", no_argument, 0, 17},
+	{"j", required_argument, 0, 18},
+	{"parse-stats", no_argument, 0, 19},
 	{0, 0, 0, 0}
 };
 
@@ -57,10 +68,16 @@ static int parseOptions(int argc, char **argv)
 						"\t--error <file>       Set where error messages are written to. Default: /dev/stderr\n"
 						"\t--no-sig             Do not listen to signals.\n"
 						"\t--no-aot             Disable AOT compilation\n"
+						"\t--lazy               Compile functions to machine code on their first call\n"
 						"\t--no-predictions     Disable value/type predictions using data flow analyzation\n"
 						"\t-O0, -O1, -O2 or -O3 Set optimization level of the jit backend\n"
+						"\t--optimize-loops     Only optimize functions containing loops, compile the rest with -O0\n"
+						"\t--compile-stats      Print compile time per optimization level and interned signatures\n"
+						"\t-j <jobs>            Parse and analyze imported scripts using up to 'jobs' threads\n"
+						"\t--parse-stats        Print the amount of parsed source code and the parser throughput\n"
 						"\t--dump-asm           Dump generated assembly code\n"
 						"\t--dump-jit           Dump JIT intermediate representation (same as --dump-asm --no-aot)\n"
+						"\t                     With --lazy functions are dumped right before their first call\n"
 						"\t--dump-predictions   Dump value/type predictions\n"
 						"\t--unsafe             Disable all assertions (such as type and boundary checks)\n"
 					"Source code can be found at https://github.com/M4GNV5/PointerScript\n", UINT32_MAX);
@@ -111,6 +128,21 @@ static int parseOptions(int argc, char **argv)
 			case 14:
 				ptrs_optimizationLevel = 3;
 				break;
+			case 15:
+				ptrs_compileLazy = true;
+				break;
+			case 16:
+				ptrs_optimizeLoops = true;
+				break;
+			case 17:
+				ptrs_compileStats = true;
+				break;
+			case 18:
+				ptrs_compileJobs = strtol(optarg, NULL, 0);
+				break;
+			case 19:
+				ptrs_parseStats = true;
+				break;
 			default:
 				fprintf(stderr, "Try '--help' for more information.\n");
 				exit(EXIT_FAILURE);
@@ -128,6 +160,25 @@ void exitOnError()
 	}
 }
 
+static void dumpFunctions()
+{
+	jit_function_t curr = jit_function_next(ptrs_jit_context, NULL);
+	while(curr != NULL)
+	{
+		// with --lazy only dump the functions that were actually called
+		bool compiled = jit_function_is_compiled(curr);
+		if(!ptrs_compileLazy || compiled)
+		{
+			if(ptrs_optimizationLevel != -1 && !compiled)
+				jit_function_optimize(curr);
+
+			const char *name = jit_function_get_meta(curr, PTRS_JIT_FUNCTIONMETA_NAME);
+			jit_dump_function(stdout, curr, name);
+		}
+		curr = jit_function_next(ptrs_jit_context, curr);
+	}
+}
+
 int main(int argc, char **argv)
 {
 	ptrs_errorfile = stderr;
@@ -157,28 +208,35 @@ int main(int argc, char **argv)
 	jit_init();
 	ptrs_initialize_nativeTypes();
 
+	if(ptrs_compileStats)
+		atexit(ptrs_jit_printCompileStats);
+	if(ptrs_parseStats)
+		atexit(ptrs_printParseStats);
+
+	// the IR is freed when a function is compiled on its first call, so with
+	// --lazy --dump-jit compileOnDemand dumps it right before
+	if(dumpOps && ptrs_compileLazy && !ptrs_compileAot)
+		ptrs_dumpOnDemand = true;
+
 	ptrs_result_t result;
 	ptrs_compilefile(&result, file);
 	ptrs_lastAst = NULL;
 
 	exitOnError();
 
-	if(dumpOps)
+	if(dumpOps && ptrs_compileLazy && ptrs_compileAot)
 	{
-		jit_function_t curr = jit_function_next(ptrs_jit_context, NULL);
-		while(curr != NULL)
-		{
-			if(ptrs_optimizationLevel != -1)
-				jit_function_optimize(curr);
-
-			const char *name = jit_function_get_meta(curr, PTRS_JIT_FUNCTIONMETA_NAME);
-			jit_dump_function(stdout, curr, name);
-			curr = jit_function_next(ptrs_jit_context, curr);
-		}
-
+		// functions are only compiled once they are called, so run the script
+		// and dump whatever was materialized when it exits
+		atexit(dumpFunctions);
+	}
+	else if(dumpOps && !ptrs_compileLazy)
+	{
+		dumpFunctions();
 		return EXIT_SUCCESS;
 	}
-	else if(ptrs_dumpFlow)
+
+	if(ptrs_dumpFlow)
 	{
 		// nothing
 	}
@@ -37,6 +37,24 @@ static jit_type_t getComparasionInstrinsicSignature()
 	return signature;
 }
 
+// emits branches to label unless both operands have the given type at runtime.
+// Returns false when one of the operands is statically known to have another type
+static bool branchUnlessTypes(jit_function_t func, ptrs_jit_var_t *left, ptrs_jit_var_t *right,
+	uint8_t type, jit_label_t *label)
+{
+	if((left->constType != PTRS_TYPE_DYNAMIC && left->constType != type)
+		|| (right->constType != PTRS_TYPE_DYNAMIC && right->constType != type))
+		return false;
+
+	jit_value_t typeVal = jit_const_int(func, nuint, type);
+	if(left->constType == PTRS_TYPE_DYNAMIC)
+		jit_insn_branch_if_not(func, jit_insn_eq(func, ptrs_jit_getType(func, left->meta), typeVal), label);
+	if(right->constType == PTRS_TYPE_DYNAMIC)
+		jit_insn_branch_if_not(func, jit_insn_eq(func, ptrs_jit_getType(func, right->meta), typeVal), label);
+
+	return true;
+}
+
 #define binary_add_cases \
 	case const_typecomp(POINTER, INT): \
 		ret.meta.type = PTRS_TYPE_POINTER; \
@@ -202,6 +220,35 @@ static jit_type_t getComparasionInstrinsicSignature()
 			} \
 		} \
 		\
+		ptrs_jit_var_t ret = { \
+			.val = jit_value_create(func, jit_type_long), \
+			.meta = jit_value_create(func, jit_type_ulong), \
+			.constType = PTRS_TYPE_DYNAMIC, \
+		}; \
+		jit_label_t done = jit_label_undefined; \
+		\
+		jit_label_t notInt = jit_label_undefined; \
+		if(branchUnlessTypes(func, &left, &right, PTRS_TYPE_INT, &notInt)) \
+		{ \
+			jit_insn_store(func, ret.val, jit_insn_##jitOp(func, left.val, right.val)); \
+			jit_insn_store(func, ret.meta, ptrs_jit_const_meta(func, PTRS_TYPE_INT)); \
+			jit_insn_branch(func, &done); \
+		} \
+		jit_insn_label(func, &notInt); \
+		\
+		jit_label_t notFloat = jit_label_undefined; \
+		if(branchUnlessTypes(func, &left, &right, PTRS_TYPE_FLOAT, &notFloat)) \
+		{ \
+			jit_value_t result = jit_insn_##jitOp(func, \
+				ptrs_jit_reinterpretCast(func, left.val, jit_type_float64), \
+				ptrs_jit_reinterpretCast(func, right.val, jit_type_float64) \
+			); \
+			jit_insn_store(func, ret.val, ptrs_jit_reinterpretCast(func, result, jit_type_long)); \
+			jit_insn_store(func, ret.meta, ptrs_jit_const_meta(func, PTRS_TYPE_FLOAT)); \
+			jit_insn_branch(func, &done); \
+		} \
+		jit_insn_label(func, &notFloat); \
+		\
 		jit_value_t args[5] = { \
 			jit_const_int(func, void_ptr, (uintptr_t)node), \
 			ptrs_jit_reinterpretCast(func, left.val, jit_type_long), \
@@ -213,7 +260,11 @@ static jit_type_t getComparasionInstrinsicSignature()
 		jit_value_t retVal = jit_insn_call_native(func, "(op " #operator ")", \
 			ptrs_intrinsic_##name, getIntrinsicSignature(), args, 5, 0); \
 		\
-		ptrs_jit_var_t ret = ptrs_jit_valToVar(func, retVal); \
+		ptrs_jit_var_t slowRet = ptrs_jit_valToVar(func, retVal); \
+		jit_insn_store(func, ret.val, slowRet.val); \
+		jit_insn_store(func, ret.meta, slowRet.meta); \
+		\
+		jit_insn_label(func, &done); \
 		if(left.constType == PTRS_TYPE_FLOAT || right.constType == PTRS_TYPE_FLOAT) \
 			ret.constType = PTRS_TYPE_FLOAT; \
 		\
@@ -305,6 +356,28 @@ static jit_type_t getComparasionInstrinsicSignature()
 		\
 		if(left.constType == PTRS_TYPE_DYNAMIC || right.constType == PTRS_TYPE_DYNAMIC) \
 		{ \
+			jit_value_t result = jit_value_create(func, jit_type_long); \
+			jit_label_t done = jit_label_undefined; \
+			\
+			jit_label_t notInt = jit_label_undefined; \
+			if(branchUnlessTypes(func, &left, &right, PTRS_TYPE_INT, &notInt)) \
+			{ \
+				jit_insn_store(func, result, jit_insn_##comparer(func, left.val, right.val)); \
+				jit_insn_branch(func, &done); \
+			} \
+			jit_insn_label(func, &notInt); \
+			\
+			jit_label_t notFloat = jit_label_undefined; \
+			if(branchUnlessTypes(func, &left, &right, PTRS_TYPE_FLOAT, &notFloat)) \
+			{ \
+				jit_insn_store(func, result, jit_insn_##comparer(func, \
+					ptrs_jit_reinterpretCast(func, left.val, jit_type_float64), \
+					ptrs_jit_reinterpretCast(func, right.val, jit_type_float64) \
+				)); \
+				jit_insn_branch(func, &done); \
+			} \
+			jit_insn_label(func, &notFloat); \
+			\
 			jit_value_t args[5] = { \
 				jit_const_int(func, void_ptr, (uintptr_t)node), \
 				ptrs_jit_reinterpretCast(func, left.val, jit_type_long), \
@@ -313,8 +386,11 @@ static jit_type_t getComparasionInstrinsicSignature()
 				right.meta \
 			}; \
 			\
-			left.val = jit_insn_call_native(func, "(op " #operator ")", \
-				ptrs_intrinsic_##name, getComparasionInstrinsicSignature(), args, 5, 0); \
+			jit_insn_store(func, result, jit_insn_call_native(func, "(op " #operator ")", \
+				ptrs_intrinsic_##name, getComparasionInstrinsicSignature(), args, 5, 0)); \
+			\
+			jit_insn_label(func, &done); \
+			left.val = result; \
 		} \
 		else if(left.constType == PTRS_TYPE_FLOAT && right.constType == PTRS_TYPE_FLOAT) \
 		{ \
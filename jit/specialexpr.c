@@ -1,3 +1,4 @@
+#include <stdio.h>
 #include <stdint.h>
 #include <string.h>
 #include <inttypes.h>
@@ -12,6 +13,7 @@
 #include "include/util.h"
 #include "include/run.h"
 #include "include/astlist.h"
+#include "vtables.h"
 #include "jit/jit-insn.h"
 #include "jit/jit-type.h"
 #include "jit/jit-value.h"
@@ -33,7 +35,7 @@ ptrs_jit_var_t ptrs_handle_call(ptrs_ast_t *node, jit_function_t func, ptrs_scop
 
 }
 
-ptrs_jit_var_t ptrs_handle_stringformat(ptrs_ast_t *node, jit_function_t func, ptrs_scope_t *scope)
+static ptrs_jit_var_t formatWithSnprintf(ptrs_ast_t *node, jit_function_t func, ptrs_scope_t *scope)
 {
 	struct ptrs_ast_strformat *expr = &node->arg.strformat;
 
@@ -59,7 +61,7 @@ ptrs_jit_var_t ptrs_handle_stringformat(ptrs_ast_t *node, jit_function_t func, p
 		curr = curr->next;
 	}
 
-	jit_type_t signature = jit_type_create_signature(jit_abi_cdecl, jit_type_sys_int, argDef, argCount, 0);
+	jit_type_t signature = ptrs_jit_getSignature(jit_abi_cdecl, jit_type_sys_int, argDef, argCount);
 
 	args[0] = jit_const_int(func, void_ptr, 0);
 	args[1] = jit_const_int(func, nuint, 0);
@@ -80,13 +82,173 @@ ptrs_jit_var_t ptrs_handle_stringformat(ptrs_ast_t *node, jit_function_t func, p
 	return ret;
 }
 
+// insertions with the default format are appended without snprintf parsing the format string
+#define PTRS_STRFORMAT_BUFFERSIZE 256
+#define PTRS_STRFORMAT_INSERTIONSIZE 32
+
+static size_t formatInt(int64_t val, char *buff)
+{
+	char digits[20];
+	uint64_t rest = val < 0 ? -(uint64_t)val : (uint64_t)val;
+	int count = 0;
+	do
+	{
+		digits[count++] = '0' + rest % 10;
+		rest /= 10;
+	} while(rest != 0);
+
+	size_t len = 0;
+	if(val < 0)
+		buff[len++] = '-';
+	while(count > 0)
+		buff[len++] = digits[--count];
+
+	return len;
+}
+static size_t formatFloat(double val, char *buff)
+{
+	return snprintf(buff, PTRS_STRFORMAT_INSERTIONSIZE, "%g", val);
+}
+static void formatInsertion(jit_function_t func, ptrs_jit_var_t val, jit_value_t *str, jit_value_t *len)
+{
+	if(val.constType == PTRS_TYPE_INT)
+	{
+		*str = jit_insn_array(func, PTRS_STRFORMAT_INSERTIONSIZE);
+		ptrs_jit_reusableCall(func, formatInt, *len, jit_type_nuint,
+			(jit_type_long, jit_type_void_ptr),
+			(val.val, *str)
+		);
+	}
+	else if(val.constType == PTRS_TYPE_FLOAT)
+	{
+		*str = jit_insn_array(func, PTRS_STRFORMAT_INSERTIONSIZE);
+		jit_value_t floatVal = ptrs_jit_reinterpretCast(func, val.val, jit_type_float64);
+		ptrs_jit_reusableCall(func, formatFloat, *len, jit_type_nuint,
+			(jit_type_float64, jit_type_void_ptr),
+			(floatVal, *str)
+		);
+	}
+	else
+	{
+		*str = ptrs_jit_vartoa(func, val).val;
+		ptrs_jit_reusableCall(func, strlen, *len, jit_type_nuint,
+			(jit_type_void_ptr),
+			(*str)
+		);
+	}
+}
+
+ptrs_jit_var_t ptrs_handle_stringformat(ptrs_ast_t *node, jit_function_t func, ptrs_scope_t *scope)
+{
+	struct ptrs_ast_strformat *expr = &node->arg.strformat;
+
+	struct ptrs_stringformat *curr = expr->insertions;
+	for(; curr != NULL; curr = curr->next)
+	{
+		if(!curr->convert)
+			return formatWithSnprintf(node, func, scope);
+	}
+
+	// without custom formats the format string only contains a %s for every insertion
+	// and %% for every literal %. The string is split into literal parts and insertions
+	int maxParts = 2 * expr->insertionCount + 1;
+	for(const char *c = expr->str; *c != 0; c++)
+	{
+		if(c[0] == '%' && c[1] == '%')
+			maxParts++;
+	}
+
+	jit_value_t partStr[maxParts];
+	jit_value_t partLen[maxParts];
+	int partCount = 0;
+	size_t literalLen = 0;
+
+	curr = expr->insertions;
+	const char *start = expr->str;
+	for(const char *c = expr->str; ; c++)
+	{
+		if(*c != 0 && *c != '%')
+			continue;
+
+		// a %% escape keeps its first % in the literal part before it
+		size_t len = c - start + (*c == '%' && c[1] == '%' ? 1 : 0);
+		if(len > 0)
+		{
+			partStr[partCount] = jit_const_int(func, void_ptr, (uintptr_t)start);
+			partLen[partCount] = jit_const_int(func, nuint, len);
+			partCount++;
+			literalLen += len;
+		}
+
+		if(*c == 0)
+			break;
+
+		if(c[1] == 's')
+		{
+			ptrs_jit_var_t val = curr->entry->vtable->get(curr->entry, func, scope);
+			formatInsertion(func, val, &partStr[partCount], &partLen[partCount]);
+			partCount++;
+			curr = curr->next;
+		}
+
+		c++;
+		start = c + 1;
+	}
+
+	jit_value_t size = jit_const_int(func, nuint, literalLen + 1);
+	for(int i = 0; i < partCount; i++)
+	{
+		if(!jit_value_is_constant(partLen[i]))
+			size = jit_insn_add(func, size, partLen[i]);
+	}
+
+	// strings which are only read by script code (e.g. converted to a number) are dead
+	// when the next one is created, so the buffer in the stack frame can be reused
+	// instead of growing the stack
+	jit_value_t buff;
+	if(expr->noEscape)
+	{
+		buff = jit_value_create(func, jit_type_void_ptr);
+		jit_label_t useAlloca = jit_label_undefined;
+		jit_label_t ready = jit_label_undefined;
+
+		jit_value_t fitsBuffer = jit_insn_le(func, size, jit_const_int(func, nuint, PTRS_STRFORMAT_BUFFERSIZE));
+		jit_insn_branch_if_not(func, fitsBuffer, &useAlloca);
+		jit_insn_store(func, buff, jit_insn_array(func, PTRS_STRFORMAT_BUFFERSIZE));
+		jit_insn_branch(func, &ready);
+
+		jit_insn_label(func, &useAlloca);
+		jit_insn_store(func, buff, jit_insn_alloca(func, size));
+		jit_insn_label(func, &ready);
+	}
+	else
+	{
+		buff = jit_insn_alloca(func, size);
+	}
+
+	jit_value_t pos = buff;
+	for(int i = 0; i < partCount; i++)
+	{
+		jit_insn_memcpy(func, pos, partStr[i], partLen[i]);
+		pos = jit_insn_add(func, pos, partLen[i]);
+	}
+	jit_insn_store_relative(func, pos, 0, jit_const_int(func, ubyte, 0));
+
+	ptrs_jit_var_t ret = {
+		.val = buff,
+		.meta = ptrs_jit_arrayMetaKnownType(func, size, PTRS_NATIVETYPE_INDEX_CHAR),
+		.constType = PTRS_TYPE_POINTER,
+	};
+	return ret;
+}
+
 ptrs_jit_var_t ptrs_handle_new(ptrs_ast_t *node, jit_function_t func, ptrs_scope_t *scope)
 {
 	struct ptrs_ast_new *expr = &node->arg.newexpr;
 	ptrs_jit_var_t val = expr->value->vtable->get(expr->value, func, scope);
 
 	return ptrs_struct_construct(node, func, scope,
-		val, expr->arguments, expr->onStack);
+		val, expr->arguments, expr->onStack || expr->noEscape, expr->noEscape);
 }
 
 ptrs_jit_var_t ptrs_handle_member(ptrs_ast_t *node, jit_function_t func, ptrs_scope_t *scope)
@@ -376,7 +538,7 @@ ptrs_jit_var_t ptrs_handle_index(ptrs_ast_t *node, jit_function_t func, ptrs_sco
 			arraySize = ptrs_jit_getArraySize(func, base.meta);
 		}
 
-		if(arraySize)
+		if(arraySize && !expr->getInBounds)
 		{
 			struct ptrs_assertion *sizeCheck = ptrs_jit_assert(node, func, scope,
 				jit_insn_lt(func, index.val, arraySize),
@@ -478,16 +640,25 @@ void ptrs_assign_index(ptrs_ast_t *node, jit_function_t func, ptrs_scope_t *scop
 	ptrs_jit_var_t index = expr->right->vtable->get(expr->right, func, scope);
 	scope->indexSize = oldArraySize;
 
-	if(base.constType == PTRS_TYPE_POINTER && jit_value_is_constant(base.meta))
+	// only identifiers reliably carry a predicted native type, see ptrs_handle_loop
+	bool knownNativeType = expr->left->vtable == &ptrs_ast_vtable_identifier && base.constNativeType != -1;
+	if(base.constType == PTRS_TYPE_POINTER && (jit_value_is_constant(base.meta) || knownNativeType))
 	{
 		ptrs_jit_typeCheck(node, func, scope, index, PTRS_TYPE_INT, "Array index needs to be of type int not %t");
-		ptrs_meta_t baseMeta = ptrs_jit_value_getMetaConstant(base.meta);
-		ptrs_nativetype_info_t *arrayType = ptrs_getNativeTypeForArray(node, baseMeta);
 
-		struct ptrs_assertion *sizeCheck = ptrs_jit_assert(node, func, scope,
-			jit_insn_lt(func, index.val, baseArraySize),
-			2, "Attempting to access index %d of an array of size %d", index.val, baseArraySize);
-		ptrs_jit_appendAssert(func, sizeCheck, jit_insn_ge(func, index.val, jit_const_long(func, ulong, 0)));
+		ptrs_nativetype_info_t *arrayType;
+		if(jit_value_is_constant(base.meta))
+			arrayType = ptrs_getNativeTypeForArray(node, ptrs_jit_value_getMetaConstant(base.meta));
+		else
+			arrayType = ptrs_getNativeTypeFromIndex(node, base.constNativeType);
+
+		if(!expr->setInBounds)
+		{
+			struct ptrs_assertion *sizeCheck = ptrs_jit_assert(node, func, scope,
+				jit_insn_lt(func, index.val, baseArraySize),
+				2, "Attempting to access index %d of an array of size %d", index.val, baseArraySize);
+			ptrs_jit_appendAssert(func, sizeCheck, jit_insn_ge(func, index.val, jit_const_long(func, ulong, 0)));
+		}
 
 		if(arrayType->varType == PTRS_TYPE_DYNAMIC)
 		{
@@ -875,6 +1046,11 @@ ptrs_jit_var_t ptrs_call_importedsymbol(ptrs_ast_t *node, jit_function_t func, p
 		else
 			val = ast->vtable->get(ast, func, scope);
 	}
+	else if(expr->prototype != NULL)
+	{
+		return ptrs_jit_callPrototype(node, func, scope,
+			stmt->symbols[expr->index], expr->prototype, arguments);
+	}
 	else if(expr->type == NULL)
 	{
 		val.val = jit_const_long(func, long, (uintptr_t)stmt->symbols[expr->index]);
@@ -1096,8 +1272,16 @@ ptrs_jit_var_t ptrs_handle_functionidentifier(ptrs_ast_t *node, jit_function_t f
 ptrs_jit_var_t ptrs_call_functionidentifier(ptrs_ast_t *node, jit_function_t func, ptrs_scope_t *scope,
 	ptrs_ast_t *caller, ptrs_typing_t *typing, struct ptrs_astlist *arguments)
 {
+	struct ptrs_ast_function *callee = node->arg.funcval;
+	jit_function_t target = callee->symbol;
+
+	// the flow analysis chose a clone specialized for the argument types of this call
+	uint8_t clone = caller->arg.call.clone;
+	if(clone > 0 && clone <= callee->cloneCount && callee->clones[clone - 1].symbol != NULL)
+		target = callee->clones[clone - 1].symbol;
+
 	return ptrs_jit_callnested(node, func, scope,
-		jit_const_int(func, void_ptr, 0), node->arg.funcval->symbol, arguments);
+		jit_const_int(func, void_ptr, 0), target, arguments);
 }
 
 ptrs_jit_var_t ptrs_handle_constant(ptrs_ast_t *node, jit_function_t func, ptrs_scope_t *scope)
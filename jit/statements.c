@@ -4,6 +4,7 @@
 #include <assert.h>
 #include <dlfcn.h>
 #include <libgen.h>
+#include <pthread.h>
 #include <jit/jit.h>
 
 #include "jit.h"
@@ -167,34 +168,154 @@ typedef struct ptrs_cache
 	const char *path;
 	ptrs_ast_t *ast;
 	ptrs_symboltable_t *symbols;
+	ptrs_arena_t *arena;
 	struct ptrs_cache *next;
 } ptrs_cache_t;
 ptrs_cache_t *ptrs_cache = NULL;
 
-static char *resolveRelPath(ptrs_ast_t *node, const char *from)
+static char *resolvePath(const char *file, const char *from)
 {
-	char *fullPath;
 	if(from[0] != '/')
 	{
-		char dirbuff[strlen(node->file) + 1];
-		strcpy(dirbuff, node->file);
+		char dirbuff[strlen(file) + 1];
+		strcpy(dirbuff, file);
 		char *dir = dirname(dirbuff);
 
 		char buff[strlen(dir) + strlen(from) + 2];
 		sprintf(buff, "%s/%s", dir, from);
 
-		fullPath = realpath(buff, NULL);
+		return realpath(buff, NULL);
 	}
 	else
 	{
-		fullPath = realpath(from, NULL);
+		return realpath(from, NULL);
 	}
+}
+static char *resolveRelPath(ptrs_ast_t *node, const char *from)
+{
+	char *fullPath = resolvePath(node->file, from);
 
 	if(fullPath == NULL)
 		ptrs_error(node, "Could not resolve path '%s'", from);
 
 	return fullPath;
 }
+
+int ptrs_compileJobs = 1;
+extern bool ptrs_dumpFlow;
+
+typedef struct ptrs_prefetch
+{
+	char *path;
+	bool started;
+	pthread_t thread;
+	ptrs_ast_t *ast;
+	ptrs_symboltable_t *symbols;
+	ptrs_arena_t *arena;
+	struct ptrs_prefetch *next;
+} ptrs_prefetch_t;
+static ptrs_prefetch_t *prefetches = NULL;
+static int prefetchThreads = 0;
+static pthread_mutex_t prefetchLock = PTHREAD_MUTEX_INITIALIZER;
+
+static void *prefetchScript(void *arg)
+{
+	ptrs_prefetch_t *entry = arg;
+	char *src = ptrs_readFile(entry->path);
+
+	entry->arena = ptrs_arena_create();
+
+	jmp_buf recovery;
+	if(src != NULL && setjmp(recovery) == 0)
+	{
+		ptrs_errorRecovery = &recovery;
+
+		ptrs_symboltable_t *symbols = NULL;
+		ptrs_ast_t *ast = ptrs_parse(src, entry->path, &symbols, entry->arena, false);
+
+		if(ptrs_analyzeFlow)
+			ptrs_flow_analyze(ast, true);
+
+		entry->symbols = symbols;
+		entry->ast = ast;
+	}
+	ptrs_errorRecovery = NULL;
+
+	if(entry->ast == NULL)
+	{
+		ptrs_arena_free(entry->arena);
+		entry->arena = NULL;
+	}
+
+	pthread_mutex_lock(&prefetchLock);
+	prefetchThreads--;
+	pthread_mutex_unlock(&prefetchLock);
+	return NULL;
+}
+
+void ptrs_prefetchImport(const char *file, const char *from)
+{
+	// with --dump-predictions the analysis has to happen in the order of compilation
+	if(ptrs_compileJobs <= 1 || ptrs_dumpFlow)
+		return;
+
+	char *path = resolvePath(file, from);
+	if(path == NULL)
+		return;
+
+	pthread_mutex_lock(&prefetchLock);
+
+	ptrs_prefetch_t *curr = prefetches;
+	while(curr != NULL)
+	{
+		if(strcmp(curr->path, path) == 0)
+			break;
+		curr = curr->next;
+	}
+
+	if(curr != NULL || prefetchThreads >= ptrs_compileJobs - 1)
+	{
+		pthread_mutex_unlock(&prefetchLock);
+		free(path);
+		return;
+	}
+
+	curr = calloc(1, sizeof(ptrs_prefetch_t));
+	curr->path = path;
+	curr->next = prefetches;
+	prefetches = curr;
+
+	curr->started = pthread_create(&curr->thread, NULL, prefetchScript, curr) == 0;
+	if(curr->started)
+		prefetchThreads++;
+
+	pthread_mutex_unlock(&prefetchLock);
+}
+
+static ptrs_ast_t *getPrefetchedScript(const char *path, ptrs_symboltable_t **symbols,
+	ptrs_arena_t **arena)
+{
+	pthread_mutex_lock(&prefetchLock);
+	ptrs_prefetch_t *curr = prefetches;
+	while(curr != NULL)
+	{
+		if(strcmp(curr->path, path) == 0)
+			break;
+		curr = curr->next;
+	}
+	pthread_mutex_unlock(&prefetchLock);
+
+	if(curr == NULL || !curr->started)
+		return NULL;
+
+	pthread_join(curr->thread, NULL);
+	curr->started = false;
+
+	*symbols = curr->symbols;
+	*arena = curr->arena;
+	return curr->ast;
+}
+
 static void importScript(ptrs_ast_t *node, jit_function_t func, ptrs_scope_t *scope,
 	ptrs_ast_t **expressions, const char *from)
 {
@@ -210,19 +331,24 @@ static void importScript(ptrs_ast_t *node, jit_function_t func, ptrs_scope_t *sc
 
 	if(cache == NULL)
 	{
-		char *src = ptrs_readFile(from);
-
 		cache = malloc(sizeof(ptrs_cache_t));
 		cache->path = from;
 		cache->ast = NULL;
 		cache->symbols = NULL;
+		cache->arena = NULL;
 		cache->next = ptrs_cache;
 		ptrs_cache = cache;
 
-		ptrs_ast_t *ast = ptrs_parse(src, from, &cache->symbols, false);
+		ptrs_ast_t *ast = getPrefetchedScript(from, &cache->symbols, &cache->arena);
+		if(ast == NULL)
+		{
+			char *src = ptrs_readFile(from);
+			cache->arena = ptrs_arena_create();
+			ast = ptrs_parse(src, from, &cache->symbols, cache->arena, false);
 
-		if(ptrs_analyzeFlow)
-			ptrs_flow_analyze(ast);
+			if(ptrs_analyzeFlow)
+				ptrs_flow_analyze(ast, true);
+		}
 
 		ast->vtable->get(ast, func, scope);
 		cache->ast = ast;
@@ -447,6 +573,10 @@ ptrs_jit_var_t ptrs_handle_delete(ptrs_ast_t *node, jit_function_t func, ptrs_sc
 	ptrs_ast_t *ast = node->arg.astval;
 	ptrs_jit_var_t val = ast->vtable->get(ast, func, scope);
 
+	// the flow analysis placed the instance on the stack
+	if(ast->vtable == &ptrs_ast_vtable_identifier && ast->arg.identifier.location->onStack)
+		return val;
+
 	if(val.constType == PTRS_TYPE_POINTER)
 	{
 		ptrs_jit_reusableCallVoid(func, free,
@@ -496,7 +626,7 @@ ptrs_jit_var_t ptrs_handle_throw(ptrs_ast_t *node, jit_function_t func, ptrs_sco
 	jit_value_t errorVal;
 	ptrs_jit_reusableCall(func, ptrs_createError, errorVal, jit_type_void_ptr,
 		(jit_type_void_ptr, jit_type_int, jit_type_void_ptr, jit_type_sys_bool),
-		(nodeVal, jit_const_int(func, int, 2), val.val, jit_const_int(func, sys_bool, 1))
+		(nodeVal, jit_const_int(func, int, 1), val.val, jit_const_int(func, sys_bool, 1))
 	);
 
 	jit_insn_throw(func, errorVal);
@@ -543,8 +673,9 @@ ptrs_jit_var_t ptrs_handle_trycatch(ptrs_ast_t *node, jit_function_t func, ptrs_
 					break;
 
 				case 1: // traceback
-					curr->arg.val = jit_insn_load_relative(func, scope->tryCatchException,
-						offsetof(ptrs_error_t, backtrace), jit_type_void_ptr);
+					ptrs_jit_reusableCall(func, ptrs_getBacktrace, curr->arg.val, jit_type_void_ptr,
+						(jit_type_void_ptr), (scope->tryCatchException)
+					);
 					tmp = jit_insn_load_relative(func, scope->tryCatchException,
 						offsetof(ptrs_error_t, backtraceLen), jit_type_int);
 					break;
@@ -612,8 +743,16 @@ ptrs_jit_var_t ptrs_handle_function(ptrs_ast_t *node, jit_function_t func, ptrs_
 
 	ast->symbol = ptrs_jit_createFunctionFromAst(node, func, &ast->func);
 
+	// clones are only called once they are built, calls inside the body of the
+	// generic version always use the generic version
+	for(int i = 0; i < ast->cloneCount; i++)
+		ast->clones[i].symbol = NULL;
+
 	ptrs_jit_buildFunction(node, ast->symbol, scope, &ast->func, NULL);
 
+	for(int i = 0; i < ast->cloneCount; i++)
+		ptrs_jit_buildClone(node, func, scope, ast->symbol, &ast->func, &ast->clones[i]);
+
 	ptrs_jit_var_t ret;
 	if(ast->isExpression)
 	{
@@ -752,7 +891,7 @@ ptrs_jit_var_t ptrs_handle_struct(ptrs_ast_t *node, jit_function_t func, ptrs_sc
 		jit_insn_default_return(ctor);
 		ptrs_jit_placeAssertions(ctor, &ctorScope);
 
-		if(ptrs_compileAot && jit_function_compile(ctor) == 0)
+		if(ptrs_compileAot && !ptrs_jit_compileFunction(ctor))
 			ptrs_error(node, "Failed compiling the constructor of function %s", struc->name);
 
 		struct ptrs_opoverload *ctorOverload = malloc(sizeof(struct ptrs_opoverload));
@@ -821,6 +960,71 @@ ptrs_jit_var_t ptrs_handle_if(ptrs_ast_t *node, jit_function_t func, ptrs_scope_
 	return condition;
 }
 
+#define PTRS_SWITCH_LINEAR_CASES 4
+
+struct ptrs_caserange
+{
+	int64_t min;
+	int64_t max;
+	jit_label_t *label;
+};
+
+static int compareCaseRanges(const void *a, const void *b)
+{
+	const struct ptrs_caserange *left = a;
+	const struct ptrs_caserange *right = b;
+
+	if(left->min < right->min)
+		return -1;
+	return left->min > right->min;
+}
+
+static void emitCaseCheck(jit_function_t func, jit_value_t val, int64_t min, int64_t max, jit_label_t *label)
+{
+	jit_value_t caseCondition;
+	if(min == max)
+	{
+		caseCondition = jit_insn_eq(func, val, jit_const_int(func, long, min));
+		jit_insn_branch_if(func, caseCondition, label);
+	}
+	else
+	{
+		jit_label_t noMatch = jit_label_undefined;
+
+		caseCondition = jit_insn_ge(func, val, jit_const_int(func, long, min));
+		jit_insn_branch_if_not(func, caseCondition, &noMatch);
+		caseCondition = jit_insn_le(func, val, jit_const_int(func, long, max));
+		jit_insn_branch_if(func, caseCondition, label);
+
+		jit_insn_label(func, &noMatch);
+	}
+}
+
+// sorted, non overlapping cases are bisected on their lower bound until only
+// a few are left, which are then checked one after the other
+static void emitCaseTree(jit_function_t func, jit_value_t val,
+	struct ptrs_caserange *ranges, int count, jit_label_t *defaultCase)
+{
+	if(count <= PTRS_SWITCH_LINEAR_CASES)
+	{
+		for(int i = 0; i < count; i++)
+			emitCaseCheck(func, val, ranges[i].min, ranges[i].max, ranges[i].label);
+
+		jit_insn_branch(func, defaultCase);
+		return;
+	}
+
+	int mid = count / 2;
+	jit_label_t upper = jit_label_undefined;
+
+	jit_value_t isUpper = jit_insn_ge(func, val, jit_const_int(func, long, ranges[mid].min));
+	jit_insn_branch_if(func, isUpper, &upper);
+	emitCaseTree(func, val, ranges, mid, defaultCase);
+
+	jit_insn_label(func, &upper);
+	emitCaseTree(func, val, ranges + mid, count - mid, defaultCase);
+}
+
 ptrs_jit_var_t ptrs_handle_switch(ptrs_ast_t *node, jit_function_t func, ptrs_scope_t *scope)
 {
 	struct ptrs_ast_switch *stmt = &node->arg.switchcase;
@@ -897,37 +1101,47 @@ ptrs_jit_var_t ptrs_handle_switch(ptrs_ast_t *node, jit_function_t func, ptrs_sc
 	else
 	{
 		jit_label_t cases[stmt->caseCount];
-		for(int i = 0; i < stmt->caseCount; i++)
-			cases[i] = jit_label_undefined;
+		jit_label_t defaultCase = jit_label_undefined;
+		struct ptrs_caserange ranges[stmt->caseCount];
 
 		for(int i = 0; curr != NULL; i++)
 		{
-			jit_value_t caseCondition;
-			if(curr->min == curr->max)
-			{
-				caseCondition = jit_insn_eq(func, val, jit_const_int(func, long, curr->min));
-				jit_insn_branch_if(func, caseCondition, cases + i);
-			}
-			else
-			{
-				jit_label_t noMatch = jit_label_undefined;
+			cases[i] = jit_label_undefined;
+			ranges[i].min = curr->min;
+			ranges[i].max = curr->max;
+			ranges[i].label = cases + i;
+			curr = curr->next;
+		}
 
-				caseCondition = jit_insn_ge(func, val, jit_const_int(func, long, curr->min));
-				jit_insn_branch_if_not(func, caseCondition, &noMatch);
-				caseCondition = jit_insn_le(func, val, jit_const_int(func, long, curr->max));
-				jit_insn_branch_if(func, caseCondition, cases + i);
+		qsort(ranges, stmt->caseCount, sizeof(struct ptrs_caserange), compareCaseRanges);
 
-				jit_insn_label(func, &noMatch);
-			}
+		// overlapping cases have to be checked in source order, as the first
+		// matching one wins
+		bool overlapping = false;
+		for(int i = 1; i < stmt->caseCount; i++)
+		{
+			if(ranges[i].min <= ranges[i - 1].max)
+				overlapping = true;
+		}
 
-			curr = curr->next;
+		if(stmt->caseCount > PTRS_SWITCH_LINEAR_CASES && !overlapping)
+		{
+			emitCaseTree(func, val, ranges, stmt->caseCount, &defaultCase);
+		}
+		else
+		{
+			curr = stmt->cases;
+			for(int i = 0; curr != NULL; i++)
+			{
+				emitCaseCheck(func, val, curr->min, curr->max, cases + i);
+				curr = curr->next;
+			}
 		}
 
+		jit_insn_label(func, &defaultCase);
 		if(stmt->defaultCase != NULL)
-		{
 			stmt->defaultCase->vtable->get(stmt->defaultCase, func, scope);
-			jit_insn_branch(func, &done);
-		}
+		jit_insn_branch(func, &done);
 
 		curr = stmt->cases;
 		int i = 0;
@@ -950,10 +1164,8 @@ ptrs_jit_var_t ptrs_handle_switch(ptrs_ast_t *node, jit_function_t func, ptrs_sc
 	jit_insn_label(func, &done);
 }
 
-ptrs_jit_var_t ptrs_handle_loop(ptrs_ast_t *node, jit_function_t func, ptrs_scope_t *scope)
+static ptrs_jit_var_t compileLoop(ptrs_ast_t *body, jit_function_t func, ptrs_scope_t *scope)
 {
-	ptrs_ast_t *body = node->arg.astval;
-
 	bool oldAllowed = scope->loopControlAllowed;
 	bool oldReturn = scope->returnForLoopControl;
 	bool oldContinueLabel = scope->hasCustomContinueLabel;
@@ -963,6 +1175,7 @@ ptrs_jit_var_t ptrs_handle_loop(ptrs_ast_t *node, jit_function_t func, ptrs_scop
 	scope->loopControlAllowed = true;
 	scope->returnForLoopControl = false;
 	scope->hasCustomContinueLabel = false;
+	scope->hasLoops = true;
 	scope->continueLabel = jit_label_undefined;
 	scope->breakLabel = jit_label_undefined;
 
@@ -991,6 +1204,65 @@ ptrs_jit_var_t ptrs_handle_loop(ptrs_ast_t *node, jit_function_t func, ptrs_scop
 	return val;
 }
 
+ptrs_jit_var_t ptrs_handle_loop(ptrs_ast_t *node, jit_function_t func, ptrs_scope_t *scope)
+{
+	struct ptrs_ast_loop *stmt = &node->arg.loop;
+
+	// variables of unknown type used as index base which are not changed in the loop
+	// get their type checked once before it. If all checks pass a version of the loop
+	// compiled for arrays of var is run, otherwise the generic version
+	ptrs_ast_t *bases[stmt->invariantBaseCount + 1];
+	struct ptrs_ast_identifier saved[stmt->invariantBaseCount + 1];
+	unsigned count = 0;
+	for(unsigned i = 0; i < stmt->invariantBaseCount; i++)
+	{
+		ptrs_jit_var_t *location = stmt->invariantBases[i]->arg.identifier.location;
+		if(!location->addressable && location->val != NULL && jit_value_get_function(location->val) == func)
+			bases[count++] = stmt->invariantBases[i];
+	}
+
+	if(count == 0)
+		return compileLoop(stmt->body, func, scope);
+
+	jit_label_t generic = jit_label_undefined;
+	jit_label_t done = jit_label_undefined;
+
+	for(unsigned i = 0; i < count; i++)
+	{
+		bool checked = false;
+		for(unsigned j = 0; j < i; j++)
+			checked = checked || bases[j]->arg.identifier.location == bases[i]->arg.identifier.location;
+
+		if(!checked)
+		{
+			ptrs_jit_var_t base = bases[i]->vtable->get(bases[i], func, scope);
+			jit_insn_branch_if_not(func, ptrs_jit_hasType(func, base.meta, PTRS_TYPE_POINTER), &generic);
+			jit_insn_branch_if_not(func, jit_insn_eq(func, ptrs_jit_getArrayTypeIndex(func, base.meta),
+				jit_const_long(func, ulong, PTRS_NATIVETYPE_INDEX_VAR)), &generic);
+		}
+
+		struct ptrs_ast_identifier *expr = &bases[i]->arg.identifier;
+		saved[i] = *expr;
+		expr->typePredicted = true;
+		expr->nativeTypePredicted = true;
+		expr->metaPrediction.type = PTRS_TYPE_POINTER;
+		expr->metaPrediction.array.typeIndex = PTRS_NATIVETYPE_INDEX_VAR;
+	}
+
+	compileLoop(stmt->body, func, scope);
+
+	for(unsigned i = 0; i < count; i++)
+		bases[i]->arg.identifier = saved[i];
+
+	jit_insn_branch(func, &done);
+	jit_insn_label(func, &generic);
+
+	ptrs_jit_var_t val = compileLoop(stmt->body, func, scope);
+
+	jit_insn_label(func, &done);
+	return val;
+}
+
 struct array_iterator_save
 {
 	ptrs_meta_t meta;
@@ -0,0 +1,46 @@
+#!/bin/bash
+
+# Measures arithmetic and comparisons on dynamically typed values. The loop
+# body is called through a function reference so no types can be inferred.
+# Set PTRS to the path of another build to compare against it.
+# Usage: ./measureArithmetic.sh [number of iterations]
+
+set -e
+
+file=$(mktemp --suffix=.ptrs)
+trap "rm -f $file" EXIT
+
+cat > "$file" <<PTRS
+import puts, clock;
+
+function step(acc, x, y)
+{
+	if(x < y)
+		return acc + x * y - y / 2;
+	else
+		return acc - x;
+}
+
+function run(stepper, initial, inc, count)
+{
+	var acc = initial;
+	var x = initial;
+	var start = clock();
+
+	for(var i = 0; i < count; i++)
+	{
+		acc = stepper(acc, x, x + inc);
+		x = x + inc;
+	}
+
+	var elapsed = (clock() - start) / 1000000.0;
+	puts("\$count iterations in \$elapsed seconds (result \$acc)");
+}
+
+var stepper = step;
+var count = ${1:-10000000};
+run(stepper, 0, 1, count);
+run(stepper, 0.0, 1.0, count);
+PTRS
+
+${PTRS:-bin/ptrs} "$file"
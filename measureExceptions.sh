@@ -0,0 +1,37 @@
+#!/bin/bash
+
+# Measures how many exceptions per second can be thrown and caught.
+# Usage: ./measureExceptions.sh [number of exceptions]
+
+set -e
+
+file=$(mktemp --suffix=.ptrs)
+trap "rm -f $file" EXIT
+
+cat > "$file" <<PTRS
+import puts, clock;
+
+function thrower(depth)
+{
+	if(depth == 0)
+		throw "err";
+	thrower(depth - 1);
+}
+
+var count = ${1:-100000};
+var caught = 0;
+var start = clock();
+
+for(var i = 0; i < count; i++)
+{
+	try
+		thrower(8);
+	catch(msg)
+		caught++;
+}
+
+var elapsed = (clock() - start) / 1000000.0;
+puts("\$caught exceptions in \$elapsed seconds");
+PTRS
+
+bin/ptrs "$file"
@@ -0,0 +1,29 @@
+#!/bin/bash
+
+# Measures the compile time overhead of the flow analysis using a generated
+# function with lots of variables and branches.
+# Usage: ./measureFlow.sh [number of variables]
+
+set -e
+
+count=${1:-5000}
+file=$(mktemp --suffix=.ptrs)
+trap "rm -f $file" EXIT
+
+echo "function generated(x)" >> "$file"
+echo "{" >> "$file"
+for ((i = 0; i < count; i++)); do
+	echo "	var v$i = $i;" >> "$file"
+	if ((i % 10 == 9)); then
+		echo "	if(x > $i)" >> "$file"
+		echo "		v$i = v$((i - 1)) * 2;" >> "$file"
+	fi
+done
+echo "	return v$((count - 1));" >> "$file"
+echo "}" >> "$file"
+
+echo "Compiling a function with $count variables"
+echo -n "with flow analysis:    "
+/usr/bin/time -f "%es" bin/ptrs --no-aot "$file"
+echo -n "without flow analysis: "
+/usr/bin/time -f "%es" bin/ptrs --no-aot --no-predictions "$file"
@@ -0,0 +1,31 @@
+#!/bin/bash
+
+# Measures the parser throughput in MB/s using a generated script.
+# Usage: ./measureParser.sh [number of functions]
+
+set -e
+
+count=${1:-20000}
+file=$(mktemp --suffix=.ptrs)
+trap "rm -f $file" EXIT
+
+for ((i = 0; i < count; i++)); do
+	cat >> "$file" <<PTRS
+// function number $i
+function func$i(a, b: int, c = 3)
+{
+	var sum = 0;
+	for(var j = 0; j < a; j++)
+	{
+		if(j % 2 == 0 && b != 0x1F)
+			sum += j * b + 1.5e2;
+		else
+			sum -= c;
+	}
+	return "result: \$sum";
+}
+PTRS
+done
+
+echo "Parsing $(du -h "$file" | cut -f1) of generated source"
+bin/ptrs --parse-stats --lazy "$file"
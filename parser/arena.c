@@ -0,0 +1,95 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "common.h"
+#include "ast.h"
+
+#define PTRS_ARENA_BLOCKSIZE (64 * 1024)
+#define PTRS_ARENA_ALIGN 16
+
+struct ptrs_arena_block
+{
+	struct ptrs_arena_block *next;
+	size_t size;
+	size_t used;
+	uint8_t data[];
+};
+
+struct ptrs_arena
+{
+	struct ptrs_arena_block *current;
+};
+
+static struct ptrs_arena_block *addBlock(ptrs_arena_t *arena, size_t size)
+{
+	struct ptrs_arena_block *block = calloc(sizeof(struct ptrs_arena_block) + size, 1);
+	if(block == NULL)
+		abort();
+
+	block->size = size;
+	block->used = 0;
+	block->next = arena->current;
+	arena->current = block;
+	return block;
+}
+
+ptrs_arena_t *ptrs_arena_create()
+{
+	ptrs_arena_t *arena = malloc(sizeof(ptrs_arena_t));
+	arena->current = NULL;
+	addBlock(arena, PTRS_ARENA_BLOCKSIZE);
+	return arena;
+}
+
+void *ptrs_arena_alloc(ptrs_arena_t *arena, size_t size)
+{
+	size = (size + PTRS_ARENA_ALIGN - 1) & ~(size_t)(PTRS_ARENA_ALIGN - 1);
+
+	struct ptrs_arena_block *block = arena->current;
+	if(block->used + size > block->size)
+	{
+		if(size > PTRS_ARENA_BLOCKSIZE / 4)
+		{
+			// big allocations get their own block, which is put behind the
+			// current one so the remaining space of it is not wasted
+			struct ptrs_arena_block *big = calloc(sizeof(struct ptrs_arena_block) + size, 1);
+			if(big == NULL)
+				abort();
+
+			big->size = size;
+			big->used = size;
+			big->next = block->next;
+			block->next = big;
+			return big->data;
+		}
+
+		block = addBlock(arena, PTRS_ARENA_BLOCKSIZE);
+	}
+
+	// blocks are allocated using calloc, so the memory is already zeroed
+	void *ptr = block->data + block->used;
+	block->used += size;
+	return ptr;
+}
+
+char *ptrs_arena_strdup(ptrs_arena_t *arena, const char *str)
+{
+	size_t len = strlen(str) + 1;
+	char *copy = ptrs_arena_alloc(arena, len);
+	memcpy(copy, str, len);
+	return copy;
+}
+
+void ptrs_arena_free(ptrs_arena_t *arena)
+{
+	struct ptrs_arena_block *curr = arena->current;
+	while(curr != NULL)
+	{
+		struct ptrs_arena_block *next = curr->next;
+		free(curr);
+		curr = next;
+	}
+
+	free(arena);
+}
@@ -5,12 +5,14 @@
 #include <ctype.h>
 #include <string.h>
 #include <math.h>
+#include <time.h>
+#include <pthread.h>
 
 #include "common.h"
 #include "../jit/jit.h"
 #include "ast.h"
 
-#define talloc(type) calloc(sizeof(type), 1)
+#define talloc(type) ptrs_arena_alloc(code->arena, sizeof(type))
 
 typedef struct code code_t;
 struct symbollist;
@@ -34,19 +36,18 @@ struct symbollist
 		struct
 		{
 			ptrs_nativetype_info_t *type; //optional
+			struct ptrs_nativeprototype *prototype; //optional
 			ptrs_ast_t *import;
 			unsigned index;
 		} imported;
 	} arg;
 	ptrs_symboltype_t type;
 	char *text;
-	struct symbollist *next;
 };
 struct typelist
 {
 	char *name;
 	ptrs_typing_t type;
-	struct typelist *next;
 };
 struct wildcardsymbol
 {
@@ -56,11 +57,25 @@ struct wildcardsymbol
 	struct wildcardsymbol *next;
 };
 
+struct symbolmapentry
+{
+	const char *key;
+	void *value;
+};
+// open addressing hash map keyed by interned names
+struct symbolmap
+{
+	struct symbolmapentry *entries;
+	uint32_t capacity;
+	uint32_t count;
+};
+
 struct ptrs_symboltable
 {
 	bool functionBoundary;
-	struct symbollist *current;
-	struct typelist *types;
+	ptrs_arena_t *arena;
+	struct symbolmap symbols;
+	struct symbolmap types;
 	struct wildcardsymbol *wildcards;
 	ptrs_symboltable_t *outer;
 };
@@ -71,6 +86,10 @@ struct code
 	char *src;
 	char curr;
 	int pos;
+	ptrs_arena_t *arena;
+	ptrs_token_t *tokens;
+	int tokenCount;
+	int token;
 	ptrs_symboltable_t *symbols;
 	bool insideIndex;
 	bool usesTryCatch;
@@ -103,10 +122,10 @@ static char readEscapeSequence(code_t *code);
 static int64_t readInt(code_t *code, int base);
 static double readDouble(code_t *code);
 
-static void addSymbol(code_t *code, char *text, ptrs_jit_var_t *location);
-static struct symbollist *addSpecialSymbol(code_t *code, char *symbol, ptrs_symboltype_t type);
+static void addSymbol(code_t *code, const char *text, ptrs_jit_var_t *location);
+static struct symbollist *addSpecialSymbol(code_t *code, const char *symbol, ptrs_symboltype_t type);
 static ptrs_ast_t *getSymbol(code_t *code, char *text);
-static void addType(code_t *code, char *name, ptrs_typing_t *type);
+static void addType(code_t *code, const char *name, ptrs_typing_t *type);
 static ptrs_typing_t *getType(code_t *code, const char *name);
 static void symbolScope_increase(code_t *code, bool functionBoundary);
 static void symbolScope_decrease(code_t *code);
@@ -117,6 +136,7 @@ static void consumec(code_t *code, char c);
 static void consumecm(code_t *code, char c, const char *msg);
 static void next(code_t *code);
 static void rawnext(code_t *code);
+static ptrs_token_t *currentToken(code_t *code);
 
 static bool skipSpaces(code_t *code);
 static bool skipComments(code_t *code);
@@ -126,13 +146,46 @@ static void unexpectedm(code_t *code, const char *expected, const char *msg);
 #define unexpected(code, expected) \
 	unexpectedm(code, expected, NULL)
 
-ptrs_ast_t *ptrs_parse(char *src, const char *filename, ptrs_symboltable_t **symbols, bool addInitRoot)
+bool ptrs_parseStats = false;
+static pthread_mutex_t parseStatsMutex = PTHREAD_MUTEX_INITIALIZER;
+static size_t parsedBytes = 0;
+static double lexTime = 0;
+static double parseTime = 0;
+
+static double getTime()
 {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+void ptrs_printParseStats()
+{
+	double total = lexTime + parseTime;
+	fprintf(stderr, "parsed %zu bytes in %.3f ms (lexing %.3f ms), %.2f MB/s\n",
+		parsedBytes, total * 1000, lexTime * 1000,
+		total > 0 ? parsedBytes / total / (1024 * 1024) : 0);
+}
+
+ptrs_ast_t *ptrs_parse(char *src, const char *filename, ptrs_symboltable_t **symbols,
+	ptrs_arena_t *arena, bool addInitRoot)
+{
+	double start = 0;
+	if(ptrs_parseStats)
+		start = getTime();
+
 	code_t code;
 	code.filename = filename;
 	code.src = src;
 	code.curr = src[0];
 	code.pos = 0;
+	code.arena = arena;
+	code.tokenCount = ptrs_lex(src, &code.tokens);
+	code.token = 0;
+
+	double lexed = 0;
+	if(ptrs_parseStats)
+		lexed = getTime();
 	code.usesTryCatch = false;
 	code.insideIndex = false;
 	code.thisVar = NULL;
@@ -163,12 +216,12 @@ ptrs_ast_t *ptrs_parse(char *src, const char *filename, ptrs_symboltable_t **sym
 	ptrs_ast_t *initRoot;
 	if(addInitRoot)
 	{
-		initRoot = talloc(ptrs_ast_t);
+		initRoot = ptrs_arena_alloc(arena, sizeof(ptrs_ast_t));
 		initRoot->vtable = &ptrs_ast_vtable_initroot;
 		initRoot->code = code.src;
 		initRoot->codepos = 0;
 		initRoot->file = code.filename;
-		addSymbol(&code, strdup("arguments"), &initRoot->arg.initroot.argumentsLocation);
+		addSymbol(&code, "arguments", &initRoot->arg.initroot.argumentsLocation);
 	}
 
 	ptrs_ast_t *ast = parseStmtList(&code, 0);
@@ -177,7 +230,7 @@ ptrs_ast_t *ptrs_parse(char *src, const char *filename, ptrs_symboltable_t **sym
 	{
 		initRoot->arg.initroot.hasTryCatch = code.usesTryCatch;
 
-		struct ptrs_astlist *entry = talloc(struct ptrs_astlist);
+		struct ptrs_astlist *entry = ptrs_arena_alloc(arena, sizeof(struct ptrs_astlist));
 		entry->entry = initRoot;
 		entry->next = ast->arg.astlist;
 		ast->arg.astlist = entry;
@@ -187,74 +240,134 @@ ptrs_ast_t *ptrs_parse(char *src, const char *filename, ptrs_symboltable_t **sym
 		symbolScope_decrease(&code);
 	else
 		*symbols = code.symbols;
+
+	free(code.tokens);
+
+	if(ptrs_parseStats)
+	{
+		double end = getTime();
+		pthread_mutex_lock(&parseStatsMutex);
+		parsedBytes += strlen(src);
+		lexTime += lexed - start;
+		parseTime += end - lexed;
+		pthread_mutex_unlock(&parseStatsMutex);
+	}
 	return ast;
 }
 
-int ptrs_ast_getSymbol(ptrs_symboltable_t *symbols, char *text, ptrs_ast_t **node)
+static uint32_t hashPointer(const void *ptr)
 {
-	bool functionBoundary = false;
-	ptrs_symboltable_t *innermost = symbols;
+	uint64_t val = (uintptr_t)ptr >> 4;
+	return (val * 0x9E3779B97F4A7C15ULL) >> 32;
+}
 
-	if(node != NULL)
-		*node = NULL;
+static void *symbolMap_get(struct symbolmap *map, const char *key)
+{
+	if(map->count == 0)
+		return NULL;
 
-	while(symbols != NULL)
+	uint32_t mask = map->capacity - 1;
+	for(uint32_t i = hashPointer(key) & mask; map->entries[i].key != NULL; i = (i + 1) & mask)
 	{
-		struct symbollist *curr = symbols->current;
-		while(curr != NULL)
-		{
-			if(strcmp(curr->text, text) == 0)
-			{
-				ptrs_ast_t *ast;
-				switch(curr->type)
-				{
-					case PTRS_SYMBOL_DEFAULT:
-						*node = ast = talloc(ptrs_ast_t);
-						ast->vtable = &ptrs_ast_vtable_identifier;
+		if(map->entries[i].key == key)
+			return map->entries[i].value;
+	}
 
-						ast->arg.identifier.location = curr->arg.location;
-						ast->arg.identifier.typePredicted = false;
-						ast->arg.identifier.valuePredicted = false;
-						ast->arg.identifier.metaPredicted = false;
+	return NULL;
+}
 
-						if(functionBoundary)
-							ast->arg.identifier.location->addressable = 1;
-						break;
+static void symbolMap_put(ptrs_arena_t *arena, struct symbolmap *map, const char *key, void *value)
+{
+	if((map->count + 1) * 4 > map->capacity * 3)
+	{
+		struct symbolmapentry *old = map->entries;
+		uint32_t oldCapacity = map->capacity;
 
-					case PTRS_SYMBOL_FUNCTION:
-						*node = ast = talloc(ptrs_ast_t);
-						ast->vtable = &ptrs_ast_vtable_functionidentifier;
+		map->capacity = oldCapacity == 0 ? 8 : oldCapacity * 2;
+		map->entries = ptrs_arena_alloc(arena, map->capacity * sizeof(struct symbolmapentry));
+		map->count = 0;
 
-						ast->arg.funcval = curr->arg.function;
-						break;
+		for(uint32_t i = 0; i < oldCapacity; i++)
+		{
+			if(old[i].key != NULL)
+				symbolMap_put(arena, map, old[i].key, old[i].value);
+		}
+	}
 
-					case PTRS_SYMBOL_CONST:
-						*node = ast = talloc(ptrs_ast_t);
-						memcpy(ast, curr->arg.data, sizeof(ptrs_ast_t));
-						break;
+	uint32_t mask = map->capacity - 1;
+	uint32_t i = hashPointer(key) & mask;
+	while(map->entries[i].key != NULL && map->entries[i].key != key)
+		i = (i + 1) & mask;
 
-					case PTRS_SYMBOL_IMPORTED:
-						*node = ast = talloc(ptrs_ast_t);
-						ast->vtable = &ptrs_ast_vtable_importedsymbol;
+	// redefining a symbol in the same scope replaces the old one
+	if(map->entries[i].key == NULL)
+		map->count++;
+	map->entries[i].key = key;
+	map->entries[i].value = value;
+}
 
-						ast->arg.importedsymbol.import = curr->arg.imported.import;
-						ast->arg.importedsymbol.index = curr->arg.imported.index;
-						ast->arg.importedsymbol.type = curr->arg.imported.type;
-						break;
+static int findSymbol(ptrs_symboltable_t *symbols, const char *text, ptrs_ast_t **node)
+{
+	bool functionBoundary = false;
+	ptrs_symboltable_t *innermost = symbols;
 
-					case PTRS_SYMBOL_THISMEMBER:
-						*node = ast = talloc(ptrs_ast_t);
-						ast->vtable = &ptrs_ast_vtable_member;
+	if(node != NULL)
+		*node = NULL;
 
-						if(ptrs_ast_getSymbol(innermost, "this", &ast->arg.member.base) != 0)
-							ptrs_error(NULL, "Internal error with thismember symbol %s", curr->text);
-						ast->arg.member.name = strdup(curr->text);
-						ast->arg.member.namelen = strlen(curr->text);
-						break;
-				}
-				return 0;
+	while(symbols != NULL)
+	{
+		struct symbollist *curr = symbolMap_get(&symbols->symbols, text);
+		if(curr != NULL)
+		{
+			ptrs_ast_t *ast;
+			switch(curr->type)
+			{
+				case PTRS_SYMBOL_DEFAULT:
+					*node = ast = ptrs_arena_alloc(innermost->arena, sizeof(ptrs_ast_t));
+					ast->vtable = &ptrs_ast_vtable_identifier;
+
+					ast->arg.identifier.location = curr->arg.location;
+					ast->arg.identifier.typePredicted = false;
+					ast->arg.identifier.valuePredicted = false;
+					ast->arg.identifier.metaPredicted = false;
+
+					if(functionBoundary)
+						ast->arg.identifier.location->addressable = 1;
+					break;
+
+				case PTRS_SYMBOL_FUNCTION:
+					*node = ast = ptrs_arena_alloc(innermost->arena, sizeof(ptrs_ast_t));
+					ast->vtable = &ptrs_ast_vtable_functionidentifier;
+
+					ast->arg.funcval = curr->arg.function;
+					break;
+
+				case PTRS_SYMBOL_CONST:
+					*node = ast = ptrs_arena_alloc(innermost->arena, sizeof(ptrs_ast_t));
+					memcpy(ast, curr->arg.data, sizeof(ptrs_ast_t));
+					break;
+
+				case PTRS_SYMBOL_IMPORTED:
+					*node = ast = ptrs_arena_alloc(innermost->arena, sizeof(ptrs_ast_t));
+					ast->vtable = &ptrs_ast_vtable_importedsymbol;
+
+					ast->arg.importedsymbol.import = curr->arg.imported.import;
+					ast->arg.importedsymbol.index = curr->arg.imported.index;
+					ast->arg.importedsymbol.type = curr->arg.imported.type;
+					ast->arg.importedsymbol.prototype = curr->arg.imported.prototype;
+					break;
+
+				case PTRS_SYMBOL_THISMEMBER:
+					*node = ast = ptrs_arena_alloc(innermost->arena, sizeof(ptrs_ast_t));
+					ast->vtable = &ptrs_ast_vtable_member;
+
+					if(findSymbol(innermost, ptrs_intern("this"), &ast->arg.member.base) != 0)
+						ptrs_error(NULL, "Internal error with thismember symbol %s", curr->text);
+					ast->arg.member.name = curr->text;
+					ast->arg.member.namelen = strlen(curr->text);
+					break;
 			}
-			curr = curr->next;
+			return 0;
 		}
 
 		functionBoundary = functionBoundary || symbols->functionBoundary;
@@ -263,6 +376,20 @@ int ptrs_ast_getSymbol(ptrs_symboltable_t *symbols, char *text, ptrs_ast_t **nod
 	return 1;
 }
 
+int ptrs_ast_getSymbol(ptrs_symboltable_t *symbols, char *text, ptrs_ast_t **node)
+{
+	// a name that was never interned cannot be the name of any symbol
+	const char *key = ptrs_intern_find(text);
+	if(key == NULL)
+	{
+		if(node != NULL)
+			*node = NULL;
+		return 1;
+	}
+
+	return findSymbol(symbols, key, node);
+}
+
 static ptrs_ast_t *parseStmtList(code_t *code, char end)
 {
 	ptrs_ast_t *elem = talloc(ptrs_ast_t);
@@ -296,10 +423,7 @@ static ptrs_ast_t *parseStmtList(code_t *code, char end)
 
 	if(curr == elem->arg.astlist)
 	{
-		free(elem);
-		elem = curr->entry;
-		free(curr);
-		return elem;
+		return curr->entry;
 	}
 	else
 	{
@@ -308,7 +432,7 @@ static ptrs_ast_t *parseStmtList(code_t *code, char end)
 	}
 }
 
-static ptrs_ast_t *astToAstlist(ptrs_ast_t *ast)
+static ptrs_ast_t *astToAstlist(code_t *code, ptrs_ast_t *ast)
 {
 	struct ptrs_astlist *entry = talloc(struct ptrs_astlist);
 	entry->entry = ast;
@@ -322,10 +446,10 @@ static ptrs_ast_t *astToAstlist(ptrs_ast_t *ast)
 
 	return ast;
 }
-static ptrs_ast_t *prependAstToAst(ptrs_ast_t *ast, ptrs_ast_t *elem)
+static ptrs_ast_t *prependAstToAst(code_t *code, ptrs_ast_t *ast, ptrs_ast_t *elem)
 {
 	if(ast->vtable != &ptrs_ast_vtable_body)
-		ast = astToAstlist(ast);
+		ast = astToAstlist(code, ast);
 
 	struct ptrs_astlist *entry = talloc(struct ptrs_astlist);
 	entry->entry = elem;
@@ -334,10 +458,10 @@ static ptrs_ast_t *prependAstToAst(ptrs_ast_t *ast, ptrs_ast_t *elem)
 
 	return ast;
 }
-static ptrs_ast_t *appendAstToAst(ptrs_ast_t *ast, ptrs_ast_t *elem)
+static ptrs_ast_t *appendAstToAst(code_t *code, ptrs_ast_t *ast, ptrs_ast_t *elem)
 {
 	if(ast->vtable != &ptrs_ast_vtable_body)
-		ast = astToAstlist(ast);
+		ast = astToAstlist(code, ast);
 
 	struct ptrs_astlist *last = ast->arg.astlist;
 	while(last->next != NULL)
@@ -412,7 +536,7 @@ static ptrs_funcparameter_t *parseArgumentDefinitionList(code_t *code,
 					PTRS_HANDLE_ASTERROR(curr->argv, "function parameter default values have to be constants");
 			}
 
-			addSymbol(code, strdup(curr->name), &curr->arg);
+			addSymbol(code, curr->name, &curr->arg);
 		}
 
 		if(code->curr == ')')
@@ -467,7 +591,7 @@ static void parseFunctionBody(code_t *code, ptrs_function_t *func)
 static void parseFunctionInto(code_t *code, ptrs_function_t *func)
 {
 	symbolScope_increase(code, true);
-	addSymbol(code, strdup("this"), &func->thisVal);
+	addSymbol(code, "this", &func->thisVal);
 
 	func->args = parseArgumentDefinitionList(code, &func->vararg, &func->retType);
 	parseFunctionBody(code, func);
@@ -633,8 +757,10 @@ static ptrs_ast_t *parseStatement(code_t *code)
 
 		stmt->arg.function.isExpression = false;
 		stmt->arg.function.symbol = NULL;
+		stmt->arg.function.clones = NULL;
+		stmt->arg.function.cloneCount = 0;
 
-		struct symbollist *symbol = addSpecialSymbol(code, strdup(func->name), PTRS_SYMBOL_FUNCTION);
+		struct symbollist *symbol = addSpecialSymbol(code, func->name, PTRS_SYMBOL_FUNCTION);
 		symbol->arg.function = &stmt->arg.function;
 
 		parseFunctionInto(code, func);
@@ -667,7 +793,7 @@ static ptrs_ast_t *parseStatement(code_t *code)
 	else if(lookahead(code, "loop"))
 	{
 		stmt->vtable = &ptrs_ast_vtable_loop;
-		stmt->arg.astval = parseBody(code, true);
+		stmt->arg.loop.body = parseBody(code, true);
 	}
 	else if(lookahead(code, "while"))
 	{
@@ -682,15 +808,15 @@ static ptrs_ast_t *parseStatement(code_t *code)
 		breakIf->arg.ifelse.elseBody = talloc(ptrs_ast_t);
 		breakIf->arg.ifelse.elseBody->vtable = &ptrs_ast_vtable_break;
 
-		stmt->arg.astval = parseBody(code, true);
-		stmt->arg.astval = prependAstToAst(stmt->arg.astval, breakIf);
+		stmt->arg.loop.body = parseBody(code, true);
+		stmt->arg.loop.body = prependAstToAst(code, stmt->arg.loop.body, breakIf);
 	}
 	else if(lookahead(code, "do"))
 	{
 		stmt->vtable = &ptrs_ast_vtable_loop;
 
 		symbolScope_increase(code, false);
-		stmt->arg.astval = parseScopelessBody(code, true);
+		stmt->arg.loop.body = parseScopelessBody(code, true);
 		consume(code, "while");
 
 		ptrs_ast_t *breakIf = talloc(ptrs_ast_t);
@@ -705,7 +831,7 @@ static ptrs_ast_t *parseStatement(code_t *code)
 		consumec(code, ';');
 		symbolScope_decrease(code);
 
-		stmt->arg.astval = appendAstToAst(stmt->arg.astval, breakIf);
+		stmt->arg.loop.body = appendAstToAst(code, stmt->arg.loop.body, breakIf);
 	}
 	else if(lookahead(code, "foreach"))
 	{
@@ -713,7 +839,7 @@ static ptrs_ast_t *parseStatement(code_t *code)
 		symbolScope_increase(code, false);
 
 		consumec(code, '(');
-		stmt->arg.forin.varsymbols = calloc(10, sizeof(ptrs_jit_var_t));
+		stmt->arg.forin.varsymbols = ptrs_arena_alloc(code->arena, 10 * sizeof(ptrs_jit_var_t));
 		int i = 0;
 		for(i = 0; i < 10; i++)
 		{
@@ -734,14 +860,14 @@ static ptrs_ast_t *parseStatement(code_t *code)
 
 		ptrs_ast_t *loopStmt = talloc(ptrs_ast_t);
 		loopStmt->vtable = &ptrs_ast_vtable_loop;
-		loopStmt->arg.astval = parseScopelessBody(code, true);
+		loopStmt->arg.loop.body = parseScopelessBody(code, true);
 
 		ptrs_ast_t *loopStep = talloc(ptrs_ast_t);
 		loopStep->vtable = &ptrs_ast_vtable_forin_step;
 		loopStep->arg.forinptr = &stmt->arg.forin;
 
-		loopStmt->arg.astval = prependAstToAst(loopStmt->arg.astval, loopStep);
-		stmt = appendAstToAst(stmt, loopStmt);
+		loopStmt->arg.loop.body = prependAstToAst(code, loopStmt->arg.loop.body, loopStep);
+		stmt = appendAstToAst(code, stmt, loopStmt);
 
 		symbolScope_decrease(code);
 	}
@@ -773,21 +899,21 @@ static ptrs_ast_t *parseStatement(code_t *code)
 		step->arg.astval = stepExpr;
 		consumec(code, ')');
 
-		stmt->arg.astval = parseScopelessBody(code, true);
+		stmt->arg.loop.body = parseScopelessBody(code, true);
 		symbolScope_decrease(code);
 
 		if(step != NULL)
 		{
 			ptrs_ast_t *contLabel = talloc(ptrs_ast_t);
 			contLabel->vtable = &ptrs_ast_vtable_continue_label;
-			stmt->arg.astval = appendAstToAst(stmt->arg.astval, contLabel);
-			stmt->arg.astval = appendAstToAst(stmt->arg.astval, step);
+			stmt->arg.loop.body = appendAstToAst(code, stmt->arg.loop.body, contLabel);
+			stmt->arg.loop.body = appendAstToAst(code, stmt->arg.loop.body, step);
 		}
 
 		if(breakIf != NULL)
-			stmt->arg.astval = prependAstToAst(stmt->arg.astval, breakIf);
+			stmt->arg.loop.body = prependAstToAst(code, stmt->arg.loop.body, breakIf);
 
-		stmt = prependAstToAst(stmt, init);
+		stmt = prependAstToAst(code, stmt, init);
 	}
 	else
 	{
@@ -1158,6 +1284,7 @@ static ptrs_ast_t *parseUnaryExpr(code_t *code, bool ignoreCalls)
 		ast = talloc(ptrs_ast_t);
 		ast->vtable = &ptrs_ast_vtable_function;
 		ast->arg.function.isExpression = true;
+		ast->arg.function.cloneCount = 0;
 
 		ptrs_function_t *func = &ast->arg.function.func;
 		func->name = "(anonymous function)";
@@ -1180,7 +1307,6 @@ static ptrs_ast_t *parseUnaryExpr(code_t *code, bool ignoreCalls)
 	{
 		char *name = readIdentifier(code);
 		ast = getSymbol(code, name);
-		free(name);
 	}
 	else if(isdigit(curr) || curr == '.' || curr == '-')
 	{
@@ -1267,7 +1393,7 @@ static ptrs_ast_t *parseUnaryExpr(code_t *code, bool ignoreCalls)
 		while(*src++ != '`')
 			len++;
 
-		char *str = malloc(len + 1);
+		char *str = ptrs_arena_alloc(code->arena, len + 1);
 		strncpy(str, &code->src[code->pos], len);
 		str[len] = 0;
 		code->pos += len + 1;
@@ -1288,7 +1414,7 @@ static ptrs_ast_t *parseUnaryExpr(code_t *code, bool ignoreCalls)
 		if(isalnum(code->curr) || (code->curr == ')'))
 		{
 			if(code->curr != ')')
-				free(readIdentifier(code));
+				readIdentifier(code);
 
 			if(code->curr == ',' || code->curr == ':'
 				|| (lookahead(code, ")") && (lookahead(code, "->") || lookahead(code, ":"))))
@@ -1301,10 +1427,11 @@ static ptrs_ast_t *parseUnaryExpr(code_t *code, bool ignoreCalls)
 				ast = talloc(ptrs_ast_t);
 				ast->vtable = &ptrs_ast_vtable_function;
 				ast->arg.function.isExpression = true;
+				ast->arg.function.cloneCount = 0;
 
 				ptrs_function_t *func = &ast->arg.function.func;
 				func->name = "(lambda expression)";
-				addSymbol(code, strdup("this"), &func->thisVal);
+				addSymbol(code, "this", &func->thisVal);
 				func->args = parseArgumentDefinitionList(code, &func->vararg, &func->retType);
 
 				consume(code, "->");
@@ -1412,6 +1539,7 @@ static ptrs_ast_t *parseUnaryExtension(code_t *code, ptrs_ast_t *ast, bool ignor
 		call->file = code->filename;
 		call->arg.call.value = ast;
 		call->arg.call.arguments = parseExpressionList(code, ')');
+		call->arg.call.clone = 0;
 
 		ast = call;
 		consumec(code, ')');
@@ -1529,7 +1657,6 @@ static void parseTyping(code_t *code, ptrs_typing_t *typing)
 
 	char *name = readIdentifier(code);
 	ptrs_typing_t *type = getType(code, name);
-	free(name);
 	if(type != NULL)
 	{
 		memcpy(typing, type, sizeof(ptrs_typing_t));
@@ -1603,6 +1730,66 @@ static void parseArrayTyping(code_t *code, ptrs_nativetype_info_t *nativeType, p
 }
 
 
+static ptrs_nativetype_info_t *readPrototypeType(code_t *code)
+{
+	ptrs_nativetype_info_t *type = readNativeType(code);
+	if(type == NULL)
+		unexpected(code, "Native type name");
+	if(type->varType == PTRS_TYPE_DYNAMIC)
+		unexpectedm(code, NULL, "Native prototypes cannot use the type var");
+
+	return type;
+}
+
+static struct ptrs_nativeprototype *parsePrototype(code_t *code, const char *name,
+	ptrs_nativetype_info_t *retType)
+{
+	struct ptrs_nativeprototype *prototype = talloc(struct ptrs_nativeprototype);
+	prototype->name = name;
+	prototype->retType = retType;
+	prototype->variadic = false;
+
+	int capacity = 8;
+	int count = 0;
+	ptrs_nativetype_info_t **params = malloc(capacity * sizeof(ptrs_nativetype_info_t *));
+	if(params == NULL)
+		abort();
+
+	consumec(code, '(');
+	if(code->curr != ')' && !lookahead(code, "void"))
+	{
+		for(;;)
+		{
+			if(lookahead(code, "..."))
+			{
+				prototype->variadic = true;
+				break;
+			}
+
+			if(count == capacity)
+			{
+				capacity *= 2;
+				params = realloc(params, capacity * sizeof(ptrs_nativetype_info_t *));
+				if(params == NULL)
+					abort();
+			}
+			params[count++] = readPrototypeType(code);
+
+			if(code->curr == ')')
+				break;
+			consumec(code, ',');
+		}
+	}
+	consumec(code, ')');
+
+	prototype->paramCount = count;
+	prototype->params = ptrs_arena_alloc(code->arena, count * sizeof(ptrs_nativetype_info_t *));
+	memcpy(prototype->params, params, count * sizeof(ptrs_nativetype_info_t *));
+	free(params);
+
+	return prototype;
+}
+
 static void parseImport(code_t *code, ptrs_ast_t *stmt)
 {
 	stmt->vtable = &ptrs_ast_vtable_import;
@@ -1611,11 +1798,26 @@ static void parseImport(code_t *code, ptrs_ast_t *stmt)
 	stmt->arg.import.count = 0;
 
 	struct ptrs_importlist **nextPtr = &stmt->arg.import.imports;
+	bool hasPrototypes = false;
 
 	for(;;)
 	{
+		// a native type or void followed by a name starts a C prototype,
+		// e.g. import double sqrt(double)
+		int pos = code->pos;
+		char start = code->curr;
+		ptrs_nativetype_info_t *retType = readNativeType(code);
+		bool isPrototype = retType != NULL || lookahead(code, "void");
+		if(isPrototype && !isalpha(code->curr) && code->curr != '_')
+		{
+			code->pos = pos;
+			code->curr = start;
+			retType = NULL;
+			isPrototype = false;
+		}
+
 		char *name = readIdentifier(code);
-		if(code->curr == '*')
+		if(!isPrototype && code->curr == '*')
 		{
 			next(code);
 
@@ -1637,29 +1839,34 @@ static void parseImport(code_t *code, ptrs_ast_t *stmt)
 			curr->name = name;
 			curr->next = NULL;
 
-			struct symbollist *symbol = addSpecialSymbol(code, NULL, PTRS_SYMBOL_IMPORTED);
-			symbol->arg.imported.import = stmt;
-			symbol->arg.imported.index = stmt->arg.import.count++;
+			ptrs_nativetype_info_t *type = NULL;
+			struct ptrs_nativeprototype *prototype = NULL;
+			if(isPrototype)
+			{
+				prototype = parsePrototype(code, name, retType);
+				hasPrototypes = true;
 
-			if(code->curr == ':')
+				if(lookahead(code, "as"))
+					name = readIdentifier(code);
+			}
+			else if(code->curr == ':')
 			{
 				next(code);
 
-				symbol->text = strdup(name);
-				symbol->arg.imported.type = readNativeType(code);
-
-				if(symbol->arg.imported.type == NULL)
+				type = readNativeType(code);
+				if(type == NULL)
 					unexpected(code, "Native type name");
 			}
-			else
+			else if(lookahead(code, "as"))
 			{
-				if(lookahead(code, "as"))
-					symbol->text = readIdentifier(code);
-				else
-					symbol->text = strdup(curr->name);
-
-				symbol->arg.imported.type = NULL;
+				name = readIdentifier(code);
 			}
+
+			struct symbollist *symbol = addSpecialSymbol(code, name, PTRS_SYMBOL_IMPORTED);
+			symbol->arg.imported.import = stmt;
+			symbol->arg.imported.index = stmt->arg.import.count++;
+			symbol->arg.imported.type = type;
+			symbol->arg.imported.prototype = prototype;
 		}
 
 		if(code->curr == ';')
@@ -1676,6 +1883,11 @@ static void parseImport(code_t *code, ptrs_ast_t *stmt)
 			const char *ending = strrchr(stmt->arg.import.from, '.');
 			stmt->arg.import.isScriptImport = ending != NULL && strcmp(ending, ".ptrs") == 0;
 
+			if(stmt->arg.import.isScriptImport && hasPrototypes)
+				unexpectedm(code, NULL, "Native prototypes cannot be imported from a script");
+			if(stmt->arg.import.isScriptImport)
+				PTRS_HANDLE_SCRIPTIMPORT(code->filename, stmt->arg.import.from);
+
 			consumec(code, ';');
 			break;
 		}
@@ -1770,7 +1982,6 @@ static void parseSwitchCase(code_t *code, ptrs_ast_t *stmt)
 					caseCount++;
 
 					currCase->min = expr->arg.constval.value.intval;
-					free(expr);
 
 					if(lookahead(code, ".."))
 					{
@@ -1779,7 +1990,6 @@ static void parseSwitchCase(code_t *code, ptrs_ast_t *stmt)
 							PTRS_HANDLE_ASTERROR(expr, "Expected integer constant");
 
 						currCase->max = expr->arg.constval.value.intval;
-						free(expr);
 					}
 					else
 					{
@@ -1883,7 +2093,7 @@ static void createStructHashmap(code_t *code, ptrs_struct_t *struc, struct ptrs_
 		}
 	}
 
-	struct ptrs_structmember *member = malloc(count * sizeof(struct ptrs_structmember));
+	struct ptrs_structmember *member = ptrs_arena_alloc(code->arena, count * sizeof(struct ptrs_structmember));
 	for(int i = 0; i < count; i++)
 		member[i].name = NULL;
 
@@ -1958,7 +2168,7 @@ static void parseMap(code_t *code, ptrs_ast_t *ast)
 			symbolScope_increase(code, true);
 
 			ptrs_function_t *func = curr->member.value.function.ast = talloc(ptrs_function_t);
-			addSymbol(code, strdup("this"), &func->thisVal);
+			addSymbol(code, "this", &func->thisVal);
 			func->name = "(map function member)";
 			func->args = parseArgumentDefinitionList(code, &func->vararg, &func->retType);
 
@@ -2034,7 +2244,7 @@ static ptrs_funcparameter_t *createParameterList(code_t *code, size_t count, ...
 		}
 
 		if(curr->name != NULL)
-			addSymbol(code, strdup(curr->name), &curr->arg);
+			addSymbol(code, curr->name, &curr->arg);
 	}
 
 	return first;
@@ -2047,25 +2257,24 @@ static void parseStruct(code_t *code, ptrs_struct_t *struc)
 	int staticMemSize = 0;
 
 	ptrs_ast_t *oldAst;
-	if(ptrs_ast_getSymbol(code->symbols, structName, &oldAst) == 0)
+	if(findSymbol(code->symbols, structName, &oldAst) == 0)
 	{
 		if(oldAst->vtable != &ptrs_ast_vtable_identifier)
 			PTRS_HANDLE_ASTERROR(NULL, "Cannot redefine special symbol %s as a struct", structName);
 
 		struc->location = oldAst->arg.varval;
-		free(oldAst);
 	}
 	else
 	{
 		struc->location = talloc(ptrs_jit_var_t);
-		addSymbol(code, strdup(structName), struc->location);
+		addSymbol(code, structName, struc->location);
 	}
 
 	ptrs_typing_t type;
 	type.meta.type = PTRS_TYPE_STRUCT;
 	ptrs_meta_setPointer(type.meta, struc);
 	type.nativetype = NULL;
-	addType(code, strdup(structName), &type);
+	addType(code, structName, &type);
 
 	struc->name = structName;
 	struc->overloads = NULL;
@@ -2095,7 +2304,7 @@ static void parseStruct(code_t *code, ptrs_struct_t *struc)
 			char *param1Name = NULL;
 
 			ptrs_function_t *func = talloc(ptrs_function_t);
-			addSymbol(code, strdup("this"), &func->thisVal);
+			addSymbol(code, "this", &func->thisVal);
 			func->vararg = NULL;
 
 			struct ptrs_opoverload *overload = talloc(struct ptrs_opoverload);
@@ -2151,7 +2360,7 @@ static void parseStruct(code_t *code, ptrs_struct_t *struc)
 						nameArg->next = func->args;
 
 						func->args = nameArg;
-						addSymbol(code, strdup(param0Name), &nameArg->arg);
+						addSymbol(code, param0Name, &nameArg->arg);
 
 						nameFormat = "%s.op this[%s]()";
 						overload->op = ptrs_ast_vtable_member.call;
@@ -2259,7 +2468,7 @@ static void parseStruct(code_t *code, ptrs_struct_t *struc)
 			if(overload->op == NULL)
 				unexpected(code, "Operator");
 
-			func->name = malloc(snprintf(NULL, 0, nameFormat, structName, param0Name, param1Name) + 1);
+			func->name = ptrs_arena_alloc(code->arena, snprintf(NULL, 0, nameFormat, structName, param0Name, param1Name) + 1);
 			sprintf(func->name, nameFormat, structName, param0Name, param1Name);
 
 			parseFunctionBody(code, func);
@@ -2272,7 +2481,7 @@ static void parseStruct(code_t *code, ptrs_struct_t *struc)
 		}
 		else if(lookahead(code, "constructor"))
 		{
-			name = malloc(structNameLen + strlen(".op constructor") + 1);
+			name = ptrs_arena_alloc(code->arena, structNameLen + strlen(".op constructor") + 1);
 			sprintf(name, "%s.op constructor", structName);
 
 			struct ptrs_opoverload *overload = talloc(struct ptrs_opoverload);
@@ -2286,7 +2495,7 @@ static void parseStruct(code_t *code, ptrs_struct_t *struc)
 		}
 		else if(lookahead(code, "destructor"))
 		{
-			name = malloc(structNameLen + strlen(".op destructor") + 1);
+			name = ptrs_arena_alloc(code->arena, structNameLen + strlen(".op destructor") + 1);
 			sprintf(name, "%s.op destructor", structName);
 
 			struct ptrs_opoverload *overload = talloc(struct ptrs_opoverload);
@@ -2345,15 +2554,15 @@ static void parseStruct(code_t *code, ptrs_struct_t *struc)
 		name = curr->name = readIdentifier(code);
 		curr->namelen = strlen(name);
 
-		addSpecialSymbol(code, strdup(name), PTRS_SYMBOL_THISMEMBER);
+		addSpecialSymbol(code, name, PTRS_SYMBOL_THISMEMBER);
 
 		if(isProperty > 0)
 		{
 			symbolScope_increase(code, true);
 
 			ptrs_function_t *func = talloc(ptrs_function_t);
-			func->name = malloc(structNameLen + strlen(name) + 6);
-			addSymbol(code, strdup("this"), &func->thisVal);
+			func->name = ptrs_arena_alloc(code->arena, structNameLen + strlen(name) + 6);
+			addSymbol(code, "this", &func->thisVal);
 			func->vararg = NULL;
 
 			if(isProperty == 1)
@@ -2380,7 +2589,7 @@ static void parseStruct(code_t *code, ptrs_struct_t *struc)
 		}
 		else if(code->curr == '(')
 		{
-			char *funcName = malloc(structNameLen + strlen(name) + 2);
+			char *funcName = ptrs_arena_alloc(code->arena, structNameLen + strlen(name) + 2);
 			sprintf(funcName, "%s.%s", structName, name);
 
 			curr->type = PTRS_STRUCTMEMBER_FUNCTION;
@@ -2538,6 +2747,15 @@ static ptrs_ast_vtable_t *readSuffixOperator(code_t *code, const char **label)
 
 static char *readIdentifier(code_t *code)
 {
+	ptrs_token_t *token = currentToken(code);
+	if(token != NULL && token->type == PTRS_TOKEN_IDENTIFIER)
+	{
+		code->pos = token->end;
+		code->curr = code->src[code->pos];
+		skipSpaces(code);
+		return token->identifier;
+	}
+
 	char val[128];
 	int i = 0;
 
@@ -2554,10 +2772,7 @@ static char *readIdentifier(code_t *code)
 	skipSpaces(code);
 
 	val[i] = 0;
-	char *_val = malloc(i + 1);
-	strcpy(_val, val);
-
-	return _val;
+	return ptrs_intern(val);
 }
 
 static char *readString(code_t *code, int *length, struct ptrs_stringformat **insertions, int *insertionCount)
@@ -2654,7 +2869,7 @@ static char *readString(code_t *code, int *length, struct ptrs_stringformat **in
 					}
 					name[j] = 0;
 
-					curr->entry = getSymbol(code, name);
+					curr->entry = getSymbol(code, ptrs_intern(name));
 				}
 			}
 			else
@@ -2684,7 +2899,10 @@ static char *readString(code_t *code, int *length, struct ptrs_stringformat **in
 	if(length != NULL)
 		*length = i;
 
-	return realloc(buff, i);
+	char *result = ptrs_arena_alloc(code->arena, i);
+	memcpy(result, buff, i);
+	free(buff);
+	return result;
 }
 
 static char readEscapeSequence(code_t *code)
@@ -2736,6 +2954,14 @@ static char readEscapeSequence(code_t *code)
 
 static int64_t readInt(code_t *code, int base)
 {
+	ptrs_token_t *token = currentToken(code);
+	if(base == 0 && token != NULL && token->type == PTRS_TOKEN_NUMBER)
+	{
+		code->pos = token->end - 1;
+		next(code);
+		return token->intval;
+	}
+
 	char *start = &code->src[code->pos];
 	char *end;
 
@@ -2747,6 +2973,14 @@ static int64_t readInt(code_t *code, int base)
 }
 static double readDouble(code_t *code)
 {
+	ptrs_token_t *token = currentToken(code);
+	if(token != NULL && token->type == PTRS_TOKEN_NUMBER)
+	{
+		code->pos = token->floatEnd - 1;
+		next(code);
+		return token->floatval;
+	}
+
 	char *start = &code->src[code->pos];
 	char *end;
 
@@ -2757,27 +2991,19 @@ static double readDouble(code_t *code)
 	return val;
 }
 
-static void addSymbol(code_t *code, char *symbol, ptrs_jit_var_t *location)
+static void addSymbol(code_t *code, const char *symbol, ptrs_jit_var_t *location)
 {
-	ptrs_symboltable_t *curr = code->symbols;
-	struct symbollist *entry = talloc(struct symbollist);
-
-	entry->type = PTRS_SYMBOL_DEFAULT;
-	entry->text = symbol;
+	struct symbollist *entry = addSpecialSymbol(code, symbol, PTRS_SYMBOL_DEFAULT);
 	entry->arg.location = location;
-	entry->next = curr->current;
-	curr->current = entry;
 }
 
-static struct symbollist *addSpecialSymbol(code_t *code, char *symbol, ptrs_symboltype_t type) //0x656590
+static struct symbollist *addSpecialSymbol(code_t *code, const char *symbol, ptrs_symboltype_t type) //0x656590
 {
-	ptrs_symboltable_t *curr = code->symbols;
 	struct symbollist *entry = talloc(struct symbollist);
 
-	entry->text = symbol;
+	entry->text = ptrs_intern(symbol);
 	entry->type = type;
-	entry->next = curr->current;
-	curr->current = entry;
+	symbolMap_put(code->arena, &code->symbols->symbols, entry->text, entry);
 
 	return entry;
 }
@@ -2801,17 +3027,17 @@ static ptrs_ast_t *getSymbolFromWildcard(code_t *code, char *text)
 					stmt->lastImport->next = import;
 				stmt->lastImport = import;
 
-				import->name = strdup(text);
+				import->name = text;
 				import->next = NULL;
 
+				// the symbol is added to the scope of the wildcard import, further
+				// uses of the same name are then resolved through the hash map
 				struct symbollist *entry = talloc(struct symbollist);
-				entry->text = strdup(text);
+				entry->text = text;
 				entry->type = PTRS_SYMBOL_IMPORTED;
 				entry->arg.imported.import = curr->importStmt;
 				entry->arg.imported.index = stmt->count++;
-
-				entry->next = symbols->current;
-				symbols->current = entry;
+				symbolMap_put(code->arena, &symbols->symbols, text, entry);
 
 				return getSymbol(code, text);
 			}
@@ -2828,7 +3054,7 @@ static ptrs_ast_t *getSymbolFromWildcard(code_t *code, char *text)
 static ptrs_ast_t *getSymbol(code_t *code, char *text)
 {
 	ptrs_ast_t *ast = NULL;
-	if(ptrs_ast_getSymbol(code->symbols, text, &ast) == 0)
+	if(findSymbol(code->symbols, text, &ast) == 0)
 	{
 		ast->file = code->filename;
 		ast->codepos = code->pos;
@@ -2845,14 +3071,13 @@ static ptrs_ast_t *getSymbol(code_t *code, char *text)
 	return ast; //doh
 }
 
-static void addType(code_t *code, char *name, ptrs_typing_t *type)
+static void addType(code_t *code, const char *name, ptrs_typing_t *type)
 {
 	struct typelist *curr = talloc(struct typelist);
-	curr->name = name;
+	curr->name = ptrs_intern(name);
 	memcpy(&curr->type, type, sizeof(ptrs_typing_t));
 
-	curr->next = code->symbols->types;
-	code->symbols->types = curr;
+	symbolMap_put(code->arena, &code->symbols->types, curr->name, curr);
 }
 
 static ptrs_typing_t *getType(code_t *code, const char *name)
@@ -2860,14 +3085,9 @@ static ptrs_typing_t *getType(code_t *code, const char *name)
 	ptrs_symboltable_t *symbols = code->symbols;
 	while(symbols != NULL)
 	{
-		struct typelist *curr = symbols->types;
-		while(curr != NULL)
-		{
-			if(strcmp(curr->name, name) == 0)
-				return &curr->type;
-			
-			curr = curr->next;
-		}
+		struct typelist *curr = symbolMap_get(&symbols->types, name);
+		if(curr != NULL)
+			return &curr->type;
 
 		symbols = symbols->outer;
 	}
@@ -2878,10 +3098,15 @@ static ptrs_typing_t *getType(code_t *code, const char *name)
 static void symbolScope_increase(code_t *code, bool functionBoundary)
 {
 	ptrs_symboltable_t *new = talloc(ptrs_symboltable_t);
+	new->arena = code->arena;
 	new->outer = code->symbols;
-	new->current = NULL;
+	new->symbols.entries = NULL;
+	new->symbols.capacity = 0;
+	new->symbols.count = 0;
+	new->types.entries = NULL;
+	new->types.capacity = 0;
+	new->types.count = 0;
 	new->wildcards = NULL;
-	new->types = NULL;
 	new->functionBoundary = functionBoundary;
 
 	code->symbols = new;
@@ -2889,41 +3114,37 @@ static void symbolScope_increase(code_t *code, bool functionBoundary)
 
 static void symbolScope_decrease(code_t *code)
 {
-	ptrs_symboltable_t *scope = code->symbols;
-	code->symbols = scope->outer;
+	// the symbols themselves are allocated in the arena of the compilation unit
+	// and are released together with it
+	code->symbols = code->symbols->outer;
+}
 
-	struct symbollist *curr = scope->current;
-	while(curr != NULL)
-	{
-		struct symbollist *old = curr;
-		curr = curr->next;
-		free(old->text);
-		free(old);
-	}
+static bool lookahead(code_t *code, const char *str)
+{
+	if(code->curr != *str)
+		return false;
 
-	struct typelist *currt = scope->types;
-	while(curr != NULL)
-	{
-		struct typelist *old = currt;
-		currt = currt->next;
-		free(old->name);
-		free(old);
-	}
+	// keywords are matched against the identifier token at the current position
+	ptrs_token_t *token = NULL;
+	if(isalpha(*str) || *str == '_')
+		token = currentToken(code);
 
-	struct wildcardsymbol *currw = scope->wildcards;
-	while(curr != NULL)
+	if(token != NULL && token->type == PTRS_TOKEN_IDENTIFIER)
 	{
-		struct wildcardsymbol *old = currw;
-		currw = currw->next;
-		free(old->start);
-		free(old);
-	}
+		int len = strlen(str);
+		if(strncmp(token->identifier, str, len) != 0)
+			return false;
 
-	free(scope);
-}
+		char last = str[len - 1];
+		char following = token->identifier[len];
+		if((isalpha(last) || last == '_') && (isalpha(following) || following == '_'))
+			return false;
+
+		code->pos = token->pos + len - 1;
+		next(code);
+		return true;
+	}
 
-static bool lookahead(code_t *code, const char *str)
-{
 	int start = code->pos;
 	while(*str)
 	{
@@ -3040,6 +3261,39 @@ static void next(code_t *code)
 	while(skipSpaces(code) || skipComments(code));
 	code->curr = code->src[code->pos];
 }
+static ptrs_token_t *currentToken(code_t *code)
+{
+	ptrs_token_t *tokens = code->tokens;
+	int pos = code->pos;
+	int i = code->token;
+
+	// the parser mostly moves forward, so first try the last used and the following token
+	if(i < code->tokenCount && tokens[i].pos == pos)
+		return &tokens[i];
+	if(i + 1 < code->tokenCount && tokens[i + 1].pos == pos)
+	{
+		code->token = i + 1;
+		return &tokens[i + 1];
+	}
+
+	int low = 0;
+	int high = code->tokenCount;
+	while(low < high)
+	{
+		int mid = low + (high - low) / 2;
+		if(tokens[mid].pos < pos)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	if(low < code->tokenCount && tokens[low].pos == pos)
+	{
+		code->token = low;
+		return &tokens[low];
+	}
+	return NULL;
+}
 static void rawnext(code_t *code)
 {
 	if(code->src[code->pos] == 0)
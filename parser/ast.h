@@ -64,9 +64,19 @@ struct ptrs_ast_import
 	const char *from;
 };
 
+struct ptrs_nativeprototype
+{
+	const char *name;
+	ptrs_nativetype_info_t *retType; //NULL for void
+	ptrs_nativetype_info_t **params;
+	int paramCount;
+	bool variadic;
+};
+
 struct ptrs_ast_importedsymbol
 {
 	ptrs_nativetype_info_t *type; //optional
+	struct ptrs_nativeprototype *prototype; //optional
 	struct ptrs_ast *import;
 	int index;
 };
@@ -80,10 +90,20 @@ struct ptrs_ast_trycatch
 	ptrs_jit_var_t retVal;
 };
 
+// a version of a function compiled with fixed types for some of its untyped
+// parameters, created by the flow analysis for calls with known argument types
+struct ptrs_functionclone
+{
+	jit_function_t symbol;
+	uint8_t *types; // type of each parameter or PTRS_TYPE_DYNAMIC
+};
+
 struct ptrs_ast_function
 {
 	jit_function_t symbol;
 	ptrs_function_t func;
+	struct ptrs_functionclone *clones;
+	uint8_t cloneCount;
 	uint8_t isExpression : 1;
 };
 
@@ -92,12 +112,15 @@ struct ptrs_ast_strformat
 	char *str;
 	struct ptrs_stringformat *insertions;
 	int insertionCount;
+	uint8_t noEscape : 1; // set by the flow analysis when the string is only read, never stored
 };
 
 struct ptrs_ast_binary
 {
 	struct ptrs_ast *left;
 	struct ptrs_ast *right;
+	uint8_t getInBounds : 1; // set by the flow analysis for indices which do not need a bounds check
+	uint8_t setInBounds : 1;
 };
 
 struct ptrs_ast_ternary
@@ -129,11 +152,13 @@ struct ptrs_ast_call
 	ptrs_typing_t typing;
 	struct ptrs_ast *value;
 	struct ptrs_astlist *arguments;
+	uint8_t clone; // 1 + index of the clone of a function to call, 0 for the generic version
 };
 
 struct ptrs_ast_new
 {
 	bool onStack;
+	bool noEscape; // set by the flow analysis, the instance can reuse the same stack slot
 	struct ptrs_ast *value;
 	struct ptrs_astlist *arguments;
 };
@@ -164,8 +189,11 @@ struct ptrs_ast_ifelse
 
 struct ptrs_ast_loop
 {
-	struct ptrs_ast *condition;
 	struct ptrs_ast *body;
+	// identifiers used as index base whose variable is not changed by the loop but has
+	// an unknown type, set by the flow analysis. See ptrs_handle_loop
+	struct ptrs_ast **invariantBases;
+	unsigned invariantBaseCount;
 };
 
 struct ptrs_ast_for
@@ -220,6 +248,7 @@ union ptrs_ast_arg
 	struct ptrs_ast_call call;
 	struct ptrs_ast_new newexpr;
 	struct ptrs_ast_ifelse ifelse;
+	struct ptrs_ast_loop loop;
 	struct ptrs_ast_switch switchcase;
 	struct ptrs_ast_for forstatement;
 	struct ptrs_ast_forin forin;
@@ -274,7 +303,41 @@ struct ptrs_importlist
 	struct ptrs_importlist *next;
 };
 
-ptrs_ast_t *ptrs_parse(char *src, const char *filename, ptrs_symboltable_t **symbols, bool addInitRoot);
+typedef struct ptrs_arena ptrs_arena_t;
+ptrs_arena_t *ptrs_arena_create();
+void *ptrs_arena_alloc(ptrs_arena_t *arena, size_t size);
+char *ptrs_arena_strdup(ptrs_arena_t *arena, const char *str);
+void ptrs_arena_free(ptrs_arena_t *arena);
+
+char *ptrs_intern(const char *str);
+char *ptrs_intern_find(const char *str);
+
+typedef enum
+{
+	PTRS_TOKEN_OTHER,
+	PTRS_TOKEN_IDENTIFIER,
+	PTRS_TOKEN_NUMBER,
+} ptrs_tokentype_t;
+
+typedef struct
+{
+	int32_t pos;
+	int32_t end;
+	ptrs_tokentype_t type;
+	int32_t floatEnd; //only valid for numbers
+	union
+	{
+		char *identifier;
+		int64_t intval;
+	};
+	double floatval;
+} ptrs_token_t;
+
+int ptrs_lex(const char *src, ptrs_token_t **tokens);
+void ptrs_printParseStats();
+
+ptrs_ast_t *ptrs_parse(char *src, const char *filename, ptrs_symboltable_t **symbols,
+	ptrs_arena_t *arena, bool addInitRoot);
 int ptrs_ast_getSymbol(ptrs_symboltable_t *symbols, char *text, ptrs_ast_t **node);
 
 #endif
@@ -67,6 +67,8 @@ typedef struct
 	int8_t constType;
 	int8_t constNativeType;
 	uint8_t addressable : 1;
+	uint8_t onStack : 1; // set by the flow analysis when the variable holds a struct allocated on the stack
+	uint32_t flowIndex; // dense index used by the flow analysis
 } ptrs_jit_var_t;
 
 typedef enum
@@ -95,6 +97,7 @@ typedef struct
 	uint32_t loopControlAllowed : 1; // whether or not continue and break are currenlt allowed
 	uint32_t returnForLoopControl : 1;
 	uint32_t hasCustomContinueLabel : 1;
+	uint32_t hasLoops : 1; // whether the current function contains a loop, used by --optimize-loops
 	jit_label_t continueLabel;
 	jit_label_t breakLabel;
 	struct ptrs_assertion *firstAssertion;
@@ -144,6 +147,7 @@ typedef enum
 	PTRS_JIT_FUNCTIONMETA_CALLBACK,
 	PTRS_JIT_FUNCTIONMETA_CLOSURE,
 	PTRS_JIT_FUNCTIONMETA_UNCHECKED,
+	PTRS_JIT_FUNCTIONMETA_CALLBACKPOOL,
 } ptrs_jit_functionmeta_t;
 typedef struct ptrs_funcparameter
 {
@@ -162,6 +166,7 @@ typedef struct
 	ptrs_funcparameter_t *args;
 	ptrs_typing_t retType;
 	struct ptrs_ast *body;
+	uint32_t flowIndex; // dense index used by the flow analysis
 } ptrs_function_t;
 
 enum ptrs_structmembertype
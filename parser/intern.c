@@ -0,0 +1,95 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "common.h"
+#include "ast.h"
+
+// identifiers are interned into a single process wide table, so symbol tables
+// can compare names by pointer. As imported scripts can be parsed by worker
+// threads (see -j) all accesses are guarded by a mutex.
+
+static pthread_mutex_t internMutex = PTHREAD_MUTEX_INITIALIZER;
+static ptrs_arena_t *internArena = NULL;
+static char **internTable = NULL;
+static uint32_t internCapacity = 0;
+static uint32_t internCount = 0;
+
+static uint32_t hashString(const char *str)
+{
+	// FNV-1a
+	uint32_t hash = 2166136261u;
+	while(*str)
+	{
+		hash ^= (uint8_t)*str++;
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+static char **findSlot(const char *str, uint32_t hash)
+{
+	uint32_t mask = internCapacity - 1;
+	uint32_t i = hash & mask;
+	while(internTable[i] != NULL && strcmp(internTable[i], str) != 0)
+		i = (i + 1) & mask;
+
+	return &internTable[i];
+}
+
+static void growTable()
+{
+	char **old = internTable;
+	uint32_t oldCapacity = internCapacity;
+
+	internCapacity = oldCapacity == 0 ? 1024 : oldCapacity * 2;
+	internTable = calloc(internCapacity, sizeof(char *));
+	if(internTable == NULL)
+		abort();
+
+	for(uint32_t i = 0; i < oldCapacity; i++)
+	{
+		if(old[i] != NULL)
+			*findSlot(old[i], hashString(old[i])) = old[i];
+	}
+
+	free(old);
+}
+
+char *ptrs_intern(const char *str)
+{
+	uint32_t hash = hashString(str);
+	pthread_mutex_lock(&internMutex);
+
+	if((internCount + 1) * 4 > internCapacity * 3)
+	{
+		if(internArena == NULL)
+			internArena = ptrs_arena_create();
+		growTable();
+	}
+
+	char **slot = findSlot(str, hash);
+	if(*slot == NULL)
+	{
+		*slot = ptrs_arena_strdup(internArena, str);
+		internCount++;
+	}
+
+	char *result = *slot;
+	pthread_mutex_unlock(&internMutex);
+	return result;
+}
+
+char *ptrs_intern_find(const char *str)
+{
+	uint32_t hash = hashString(str);
+	char *result = NULL;
+	pthread_mutex_lock(&internMutex);
+
+	if(internCapacity != 0)
+		result = *findSlot(str, hash);
+
+	pthread_mutex_unlock(&internMutex);
+	return result;
+}
@@ -0,0 +1,120 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "common.h"
+#include "ast.h"
+
+static ptrs_token_t *addToken(ptrs_token_t **tokens, int *count, int *capacity, int pos)
+{
+	if(*count == *capacity)
+	{
+		*capacity *= 2;
+		*tokens = realloc(*tokens, *capacity * sizeof(ptrs_token_t));
+		if(*tokens == NULL)
+			abort();
+	}
+
+	ptrs_token_t *token = &(*tokens)[(*count)++];
+	token->pos = pos;
+	token->type = PTRS_TOKEN_OTHER;
+	return token;
+}
+
+int ptrs_lex(const char *src, ptrs_token_t **result)
+{
+	int count = 0;
+	int capacity = 1024;
+	ptrs_token_t *tokens = malloc(capacity * sizeof(ptrs_token_t));
+	if(tokens == NULL)
+		abort();
+
+	int pos = 0;
+	if(src[0] == '#' && src[1] == '!')
+	{
+		while(src[pos] != '\n' && src[pos] != 0)
+			pos++;
+	}
+
+	while(src[pos] != 0)
+	{
+		char curr = src[pos];
+
+		if(isspace(curr))
+		{
+			pos++;
+			continue;
+		}
+		else if(curr == '/' && src[pos + 1] == '/')
+		{
+			while(src[pos] != '\n' && src[pos] != 0)
+				pos++;
+			continue;
+		}
+		else if(curr == '/' && src[pos + 1] == '*')
+		{
+			pos += 2;
+			while(src[pos] != 0 && (src[pos] != '*' || src[pos + 1] != '/'))
+				pos++;
+			if(src[pos] != 0)
+				pos += 2;
+			continue;
+		}
+
+		ptrs_token_t *token = addToken(&tokens, &count, &capacity, pos);
+		if(isalpha(curr) || curr == '_')
+		{
+			char val[128];
+			int i = 0;
+			while(isalnum(src[pos]) || src[pos] == '_')
+			{
+				if(i < 127)
+					val[i++] = src[pos];
+				pos++;
+			}
+
+			// overlong identifiers are left to the character based parser
+			if(i < 127)
+			{
+				val[i] = 0;
+				token->type = PTRS_TOKEN_IDENTIFIER;
+				token->identifier = ptrs_intern(val);
+			}
+		}
+		else if(isdigit(curr))
+		{
+			char *end;
+			token->type = PTRS_TOKEN_NUMBER;
+			token->intval = strtol(&src[pos], &end, 0);
+			token->end = end - src;
+
+			token->floatval = strtod(&src[pos], &end);
+			token->floatEnd = end - src;
+
+			pos = token->end > token->floatEnd ? token->end : token->floatEnd;
+			continue;
+		}
+		else if(curr == '"' || curr == '\'')
+		{
+			pos++;
+			while(src[pos] != curr && src[pos] != 0)
+			{
+				if(src[pos] == '\\' && src[pos + 1] != 0)
+					pos++;
+				pos++;
+			}
+			if(src[pos] != 0)
+				pos++;
+		}
+		else
+		{
+			pos++;
+		}
+
+		token->end = pos;
+	}
+
+	*result = tokens;
+	return count;
+}
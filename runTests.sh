@@ -30,12 +30,32 @@ function runTestWithArgs
 	fi
 }
 
+function checkBoundsChecks
+{
+	printf "${yellow}TRYING${nocolor} bounds check removal in $1\n"
+
+	# annotations follow the source line they belong to
+	local missing=$(bin/ptrs --dump-predictions tests/$1.ptrs | awk '
+		/└/ { if(/bounds check removed/) removed[src] = 1; next }
+		/\[[a-z]+\]/ { src = $0; lines[src] = 1 }
+		END { for(line in lines) if(!removed[line]) print line }
+	')
+
+	if [ "$missing" != "" ]; then
+		printf "\n${red}ERROR${nocolor} bounds checks not removed in $1:\n$missing\n"
+		hadError=1
+	else
+		printf "\e[1A${green}SUCCESS${nocolor} bounds check removal in $1\n"
+	fi
+}
+
 function runTest
 {
 	runTestWithArgs "$1"
 	runTestWithArgs "$1" -O0
 	runTestWithArgs "$1" -O1
 	runTestWithArgs "$1" -O2
+	runTestWithArgs "$1" --lazy
 	runTestWithArgs "$1" --no-predictions
 	runTestWithArgs "$1" "--no-predictions -O0"
 	runTestWithArgs "$1" "--no-predictions -O1"
@@ -57,6 +77,8 @@ runTest runtime/functions "$1"
 runTest runtime/alignment "$1"
 runTest runtime/operators "$1"
 
+checkBoundsChecks flow/boundschecks
+
 if [ $hadError -ne 0 ]; then
 	exit 1
 fi